@@ -132,3 +132,50 @@ do
 
 	filter {} -- clear the active filter
 end
+
+-- ---------------------------------------------------------------------------
+-- Benchmarks
+--
+-- Micro benchmark drivers for the core headers, see tools/bench/bench.hpp.
+-- They only use src/core, so no Vulkan or GLFW is linked. Measure with the
+-- Release configuration, which builds them next to the engine:
+--   ninja -C build Release
+--   build/AlineBench_release [name...]
+-- ---------------------------------------------------------------------------
+
+project "Bench"
+do
+	kind "ConsoleApp"
+	language "C++"
+
+	targetdir "build"
+	objdir "build/obj/bench/%{cfg.buildcfg}"
+
+	files {
+		"tools/bench/**.cpp",
+		"tools/bench/**.hpp",
+	}
+
+	includedirs {
+		"src",
+	}
+
+	buildoptions { "-std=c++26", "-Wall", "-fdiagnostics-absolute-paths" }
+
+	filter "configurations:Debug"
+	do
+		defines { "DEBUG" }
+		symbols "On"
+		optimize "Off"
+		targetname "AlineBench_debug"
+	end
+
+	filter "configurations:Release"
+	do
+		defines { "NDEBUG" }
+		optimize "On"
+		targetname "AlineBench_release"
+	end
+
+	filter {} -- clear the active filter
+end
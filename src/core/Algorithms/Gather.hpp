@@ -0,0 +1,199 @@
+#pragma once
+
+#include "../Containers.hpp"
+#include "../core.hpp"
+
+#include <cstring>
+#include <immintrin.h>
+#include <type_traits>
+
+namespace AE
+{
+
+namespace Detail
+{
+
+// Fields up to a cache line wide, made of 4 byte words, go through the SIMD
+// gather/scatter paths
+template <typename T>
+concept word_strided = std::is_trivially_copyable_v<T> &&
+                       sizeof(T) % sizeof(u32) == 0u && sizeof(T) <= 64u;
+
+/*
+ * Byte offsets, relative to the first of Lanes elements, of every u32 word of
+ * those elements once they are packed. Packed word j of a group lives at
+ * element j / W, word j % W. The Lanes * W words are split in W registers.
+ */
+template <u32 Lanes, u32 W>
+inline void strided_word_offsets(u32 stride, i32 (&out_offsets)[W][Lanes])
+{
+    for (u32 reg = 0; reg < W; reg++)
+    {
+        for (u32 lane = 0; lane < Lanes; lane++)
+        {
+            const u32 word = reg * Lanes + lane;
+            out_offsets[reg][lane] =
+                (i32)((word / W) * stride + (word % W) * sizeof(u32));
+        }
+    }
+}
+
+/*
+ * Gathers the first round_down(count, 8) elements, returns how many. Offsets
+ * are relative to the group, so they can't overflow i32 whatever the total
+ * size of src is.
+ */
+template <typename T>
+TARGET_AVX2 inline u32 gather_avx2(const u8* src_bytes, u32 stride, u32 count,
+                                   T* dst)
+{
+    constexpr u32 Lanes = 8u;
+    constexpr u32 W     = sizeof(T) / sizeof(u32);
+
+    alignas(32) i32 offsets[W][Lanes];
+    strided_word_offsets<Lanes, W>(stride, offsets);
+
+    __m256i offset_regs[W];
+    for (u32 reg = 0; reg < W; reg++)
+    {
+        offset_regs[reg] = _mm256_load_si256((const __m256i*)offsets[reg]);
+    }
+
+    const u32 num_simd = round_down(count, Lanes);
+    for (u32 i = 0; i < num_simd; i += Lanes)
+    {
+        const int* group_base =
+            reinterpret_cast<const int*>(src_bytes + (size_t)i * stride);
+        __m256i* out = reinterpret_cast<__m256i*>(&dst[i]);
+
+        for (u32 reg = 0; reg < W; reg++)
+        {
+            const __m256i words =
+                _mm256_i32gather_epi32(group_base, offset_regs[reg], 1);
+            _mm256_storeu_si256(&out[reg], words);
+        }
+    }
+    return num_simd;
+}
+
+/*
+ * Scatters the first round_down(count, 16) elements, returns how many.
+ */
+template <typename T>
+TARGET_AVX512 inline u32 scatter_avx512(const T* src, u8* dst_bytes, u32 stride,
+                                        u32 count)
+{
+    constexpr u32 Lanes = 16u;
+    constexpr u32 W     = sizeof(T) / sizeof(u32);
+
+    alignas(64) i32 offsets[W][Lanes];
+    strided_word_offsets<Lanes, W>(stride, offsets);
+
+    __m512i offset_regs[W];
+    for (u32 reg = 0; reg < W; reg++)
+    {
+        offset_regs[reg] = _mm512_load_si512(offsets[reg]);
+    }
+
+    const u32 num_simd = round_down(count, Lanes);
+    for (u32 i = 0; i < num_simd; i += Lanes)
+    {
+        void*          group_base = dst_bytes + (size_t)i * stride;
+        const __m512i* in         = reinterpret_cast<const __m512i*>(&src[i]);
+
+        for (u32 reg = 0; reg < W; reg++)
+        {
+            const __m512i words = _mm512_loadu_si512(&in[reg]);
+            _mm512_i32scatter_epi32(group_base, offset_regs[reg], words, 1);
+        }
+    }
+    return num_simd;
+}
+
+} // namespace Detail
+
+/*
+ * Copies the strided elements of src (e.g. one member out of an array of
+ * structs) into the packed dst. On CPUs with AVX2 8 words are gathered per
+ * instruction. src may be a view of const or mutable elements:
+ *
+ *  AE::gather(CreateStridedView(particles, &Particle::position), positions);
+ */
+template <typename T>
+inline void gather(StridedView<T> src, View<std::remove_const_t<T>> dst)
+{
+    using ElemT = std::remove_const_t<T>;
+
+    assert(dst.NumElements >= src.NumElements);
+
+    const u8* src_bytes = reinterpret_cast<const u8*>(src.Data);
+    u32       i         = 0;
+
+    if constexpr (Detail::word_strided<ElemT>)
+    {
+        if (Intrinsics::cpu_features().avx2)
+        {
+            i = Detail::gather_avx2(src_bytes, src.Stride, src.NumElements,
+                                    dst.Data);
+        }
+    }
+
+    for (; i < src.NumElements; i++)
+    {
+        memcpy(&dst.Data[i], src_bytes + (size_t)i * src.Stride, sizeof(ElemT));
+    }
+}
+
+/*
+ * Gathers into a packed array, which is grown to fit.
+ */
+template <typename T>
+inline void gather(StridedView<T> src, Array<std::remove_const_t<T>>& dst)
+{
+    dst.NumElements = 0u;
+    if (src.NumElements == 0u)
+    {
+        return;
+    }
+
+    dst.add_no_init(src.NumElements);
+    gather(src, CreateView(dst));
+}
+
+/*
+ * Writes the packed src back into the strided dst. AVX2 has no scatter, on
+ * CPUs with AVX-512 16 words are scattered per instruction, otherwise the
+ * stores are done per element.
+ */
+template <typename T>
+inline void scatter(View<const T> src, StridedView<T> dst)
+{
+    assert(dst.NumElements >= src.NumElements);
+
+    u8* dst_bytes = reinterpret_cast<u8*>(dst.Data);
+    u32 i         = 0;
+
+    if constexpr (Detail::word_strided<T>)
+    {
+        if (Intrinsics::cpu_features().avx512)
+        {
+            i = Detail::scatter_avx512(src.Data, dst_bytes, dst.Stride,
+                                       src.NumElements);
+        }
+    }
+
+    for (; i < src.NumElements; i++)
+    {
+        memcpy(dst_bytes + (size_t)i * dst.Stride, &src.Data[i], sizeof(T));
+    }
+}
+
+template <typename T>
+    requires(!std::is_const_v<T>)
+inline void scatter(View<T> src, StridedView<T> dst)
+{
+    View<const T> const_src = {.Data = src.Data, .NumElements = src.NumElements};
+    scatter(const_src, dst);
+}
+
+} // namespace AE
@@ -0,0 +1,387 @@
+#pragma once
+
+#include "../Allocators.hpp"
+#include "../Containers.hpp"
+#include "../core.hpp"
+
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/*
+ * Lazy range pipeline over Views/Arrays.
+ *
+ *  View<const Object> objects = ...;
+ *  View<u64> keys = AE::range(objects)
+ *                       .filter([](const Object& o) { return o.visible; })
+ *                       .transform([](const Object& o) { return o.sort_key; })
+ *                       .collect(frame_arena);
+ *
+ * Every stage wraps the previous one and pushes elements into the next stage's
+ * sink, so the whole pipeline is inlined into a single loop over the source.
+ * Nothing is allocated until collect().
+ */
+namespace AE
+{
+
+template <typename SourceT>
+struct Range;
+
+namespace Detail
+{
+
+template <typename T>
+struct ViewSource
+{
+    using value_type = T&;
+
+    View<T> view;
+
+    template <typename SinkT>
+    inline void run(SinkT&& sink) const
+    {
+        for (u32 i = 0; i < view.NumElements; i++)
+        {
+            sink(view.Data[i]);
+        }
+    }
+
+    inline u32 max_size() const { return view.NumElements; }
+};
+
+template <typename T>
+struct ChunkSource
+{
+    using value_type = View<T>;
+
+    View<T> view;
+    u32     chunk_size;
+
+    template <typename SinkT>
+    inline void run(SinkT&& sink) const
+    {
+        for (u32 i = 0; i < view.NumElements; i += chunk_size)
+        {
+            const u32 num_in_chunk = std::min(chunk_size, view.NumElements - i);
+            sink(View<T>{.Data = &view.Data[i], .NumElements = num_in_chunk});
+        }
+    }
+
+    inline u32 max_size() const
+    {
+        return (view.NumElements + chunk_size - 1u) / chunk_size;
+    }
+};
+
+template <typename A, typename B>
+struct ZipPair
+{
+    A& first;
+    B& second;
+};
+
+template <typename A, typename B>
+struct ZipSource
+{
+    using value_type = ZipPair<A, B>;
+
+    View<A> a;
+    View<B> b;
+
+    template <typename SinkT>
+    inline void run(SinkT&& sink) const
+    {
+        const u32 num_elements = max_size();
+        for (u32 i = 0; i < num_elements; i++)
+        {
+            sink(ZipPair<A, B>{a.Data[i], b.Data[i]});
+        }
+    }
+
+    inline u32 max_size() const
+    {
+        return std::min(a.NumElements, b.NumElements);
+    }
+};
+
+template <typename SourceT, typename PredT>
+struct FilterStage
+{
+    using value_type = typename SourceT::value_type;
+
+    SourceT source;
+    PredT   pred;
+
+    template <typename SinkT>
+    inline void run(SinkT&& sink) const
+    {
+        source.run(
+            [&](value_type elem)
+            {
+                if (pred(elem))
+                {
+                    sink(std::forward<value_type>(elem));
+                }
+            });
+    }
+
+    inline u32 max_size() const { return source.max_size(); }
+};
+
+template <typename SourceT, typename FuncT>
+struct TransformStage
+{
+    using value_type =
+        std::invoke_result_t<const FuncT&, typename SourceT::value_type>;
+
+    SourceT source;
+    FuncT   func;
+
+    template <typename SinkT>
+    inline void run(SinkT&& sink) const
+    {
+        source.run([&](typename SourceT::value_type elem)
+                   { sink(func(std::forward<decltype(elem)>(elem))); });
+    }
+
+    inline u32 max_size() const { return source.max_size(); }
+};
+
+template <typename T>
+struct Enumerated
+{
+    u32 index;
+    T   value;
+};
+
+template <typename SourceT>
+struct EnumerateStage
+{
+    using value_type = Enumerated<typename SourceT::value_type>;
+
+    SourceT source;
+
+    template <typename SinkT>
+    inline void run(SinkT&& sink) const
+    {
+        u32 index = 0u;
+        source.run(
+            [&](typename SourceT::value_type elem) {
+                sink(value_type{index++,
+                                std::forward<decltype(elem)>(elem)});
+            });
+    }
+
+    inline u32 max_size() const { return source.max_size(); }
+};
+
+/*
+ * Value type collect() stores for a pipeline element: references decay to
+ * copies, including the ones held by zip pairs and enumerated elements.
+ */
+template <typename A, typename B>
+struct ZipValue
+{
+    A first;
+    B second;
+};
+
+template <typename T>
+struct Collected
+{
+    using type = T;
+
+    static inline const T& make(const T& elem) { return elem; }
+};
+
+template <typename A, typename B>
+struct Collected<ZipPair<A, B>>
+{
+    using type = ZipValue<std::remove_const_t<A>, std::remove_const_t<B>>;
+
+    static inline type make(const ZipPair<A, B>& elem)
+    {
+        return {elem.first, elem.second};
+    }
+};
+
+template <typename T>
+struct Collected<Enumerated<T>>
+{
+    using Inner = Collected<std::remove_cvref_t<T>>;
+    using type  = Enumerated<typename Inner::type>;
+
+    static inline type make(const Enumerated<T>& elem)
+    {
+        return {elem.index, Inner::make(elem.value)};
+    }
+};
+
+template <typename T>
+using collected_t = typename Collected<std::remove_cvref_t<T>>::type;
+
+} // namespace Detail
+
+template <typename SourceT>
+struct Range
+{
+    using value_type = typename SourceT::value_type;
+    using elem_type  = Detail::collected_t<value_type>;
+
+    SourceT source;
+
+    // ---------------- Stages ----------------
+
+    template <typename PredT>
+    inline Range<Detail::FilterStage<SourceT, PredT>> filter(PredT pred) const
+    {
+        return {{source, pred}};
+    }
+
+    template <typename FuncT>
+    inline Range<Detail::TransformStage<SourceT, FuncT>>
+    transform(FuncT func) const
+    {
+        return {{source, func}};
+    }
+
+    inline Range<Detail::EnumerateStage<SourceT>> enumerate() const
+    {
+        return {{source}};
+    }
+
+    // ---------------- Terminal operations ----------------
+
+    template <typename FuncT>
+    inline void for_each(FuncT&& func) const
+    {
+        source.run(func);
+    }
+
+    inline u32 count() const
+    {
+        u32 result = 0u;
+        source.run([&](value_type) { result++; });
+        return result;
+    }
+
+    // Upper bound of the number of elements the pipeline produces
+    inline u32 max_size() const { return source.max_size(); }
+
+    /*
+     * Runs the pipeline into arena memory. Room for max_size() elements is
+     * reserved up front, the unused tail is handed back to the arena when the
+     * result is still its last allocation.
+     */
+    template <size_t _Alignment>
+    View<elem_type> collect(ArenaAllocator<_Alignment>& arena) const
+    {
+        static_assert(std::is_trivially_copyable_v<elem_type>);
+
+        const u32 capacity = max_size();
+        if (capacity == 0u)
+        {
+            return {.Data = nullptr, .NumElements = 0u};
+        }
+
+        MemoryHandle handle = arena.Allocate(sizeof(elem_type) * capacity,
+                                             {true, alignof(elem_type)});
+        assert(handle.is_valid());
+
+        elem_type* data = static_cast<elem_type*>(arena.HandleToPtr(handle));
+
+        u32 num_elements = 0u;
+        source.run(
+            [&](value_type elem)
+            { new (&data[num_elements++]) elem_type(Collector::make(elem)); });
+
+        if (arena.buffer_offset == handle.offset + handle.size)
+        {
+            arena.buffer_offset =
+                handle.offset + sizeof(elem_type) * num_elements;
+        }
+
+        return {.Data = data, .NumElements = num_elements};
+    }
+
+    /*
+     * Appends the output of the pipeline to an existing array.
+     */
+    void collect(Array<elem_type>& out) const
+    {
+        out.Reserve(out.NumElements + std::max(max_size(), 1u));
+        source.run([&](value_type elem)
+                   {
+                       new (&out.Data[out.NumElements++])
+                           elem_type(Collector::make(elem));
+                   });
+    }
+
+  private:
+    using Collector = Detail::Collected<std::remove_cvref_t<value_type>>;
+};
+
+// ---------------- Sources ----------------
+
+template <typename T>
+inline Range<Detail::ViewSource<T>> range(View<T> view)
+{
+    return {{view}};
+}
+
+template <typename T>
+inline Range<Detail::ViewSource<T>> range(Array<T>& array)
+{
+    return {{CreateView(array)}};
+}
+
+template <typename T>
+inline Range<Detail::ViewSource<const T>> range(const Array<T>& array)
+{
+    return {{CreateConstView(array)}};
+}
+
+/*
+ * Splits the view in consecutive sub views of chunk_size elements (the last
+ * one can be shorter), e.g. to hand fixed size batches to a SIMD kernel.
+ */
+template <typename T>
+inline Range<Detail::ChunkSource<T>> chunk(View<T> view, u32 chunk_size)
+{
+    assert(chunk_size > 0u);
+    return {{view, chunk_size}};
+}
+
+/*
+ * Pairs up the elements of two views, stops at the end of the shorter one.
+ */
+template <typename A, typename B>
+inline Range<Detail::ZipSource<A, B>> zip(View<A> a, View<B> b)
+{
+    return {{a, b}};
+}
+
+namespace Detail
+{
+
+// Compile check: every source and stage can be collected into both sinks
+[[maybe_unused]] inline void range_collect_check(ArenaAllocator<>& arena,
+                                                 View<const u32> a,
+                                                 View<float>     b)
+{
+    Array<u32> out(arena, 4u);
+
+    (void)range(a).collect(arena);
+    (void)range(a).filter([](u32 x) { return x != 0u; }).collect(arena);
+    (void)range(a).transform([](u32 x) { return (float)x; }).collect(arena);
+    (void)range(a).enumerate().collect(arena);
+    (void)range(b).enumerate().collect(arena);
+    (void)chunk(a, 4u).collect(arena);
+    (void)zip(a, b).collect(arena);
+    (void)zip(a, b).enumerate().collect(arena);
+    range(a).collect(out);
+}
+
+} // namespace Detail
+
+} // namespace AE
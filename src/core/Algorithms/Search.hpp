@@ -1,7 +1,12 @@
 #pragma once
 
+#include "../Allocators.hpp"
 #include "../Containers.hpp"
+#include "../Intrinsics.hpp"
 
+#include <functional>
+#include <immintrin.h>
+#include <type_traits>
 #include <utility>
 
 namespace AE
@@ -9,22 +14,22 @@ namespace AE
 
 template <typename T, class... Args>
 inline constexpr auto Invoke(T&& obj, Args&&... args)
-    -> decltype((std::forward(obj))(std::forward(args)...))
+    -> decltype((std::forward<T>(obj))(std::forward<Args>(args)...))
 {
-    return (std::forward(obj))(std::forward(args)...);
+    return (std::forward<T>(obj))(std::forward<Args>(args)...);
 }
 
 template<typename T>
 struct EqualOp
 {
-    inline constexpr bool operator()(const T&& a, const T&& b) const { return std::forward(a) == std::forward(b); }
+    inline constexpr bool operator()(const T& a, const T& b) const { return a == b; }
 };
 
 template<>
 struct EqualOp<void>
 {
 	template<typename Ta, typename Tb>
-    inline constexpr bool operator()(const Ta&& a, const Tb&& b) const { return std::forward(a) == std::forward(b); }
+    inline constexpr bool operator()(const Ta& a, const Tb& b) const { return a == b; }
 };
 
 template <typename ArrayType, typename ElemType, typename ComparatorT>
@@ -43,10 +48,339 @@ template <typename ArrayType, typename ElemType, typename ComparatorT>
     return -1;
 }
 
+namespace Detail
+{
+
+// Element types that can be compared bitwise in SIMD lanes
+template <typename T>
+concept simd_searchable =
+    (std::is_integral_v<T> || std::is_pointer_v<T> || std::is_enum_v<T>) &&
+    (sizeof(T) == 1u || sizeof(T) == 2u || sizeof(T) == 4u || sizeof(T) == 8u);
+
+template <typename T>
+inline u64 lane_bits(const T& value)
+{
+    if constexpr (std::is_pointer_v<T>)
+    {
+        return (u64)(uintptr_t)value;
+    }
+    else
+    {
+        return (u64)value;
+    }
+}
+
+template <u32 ElemSize>
+inline __m128i search_broadcast_sse2(u64 bits)
+{
+    if constexpr (ElemSize == 1u) return _mm_set1_epi8((char)bits);
+    if constexpr (ElemSize == 2u) return _mm_set1_epi16((short)bits);
+    if constexpr (ElemSize == 4u) return _mm_set1_epi32((int)bits);
+    if constexpr (ElemSize == 8u) return _mm_set1_epi64x((long long)bits);
+}
+
+template <u32 ElemSize>
+inline u32 search_match_mask_sse2(const void* data, __m128i needle)
+{
+    const __m128i block = _mm_loadu_si128((const __m128i*)data);
+
+    if constexpr (ElemSize == 8u)
+    {
+        // SSE2 has no 64 bit compare: both 32 bit halves have to match
+        const __m128i eq32    = _mm_cmpeq_epi32(block, needle);
+        const __m128i swapped = _mm_shuffle_epi32(eq32, _MM_SHUFFLE(2, 3, 0, 1));
+        return (u32)_mm_movemask_epi8(_mm_and_si128(eq32, swapped));
+    }
+    else
+    {
+        __m128i eq;
+        if constexpr (ElemSize == 1u) eq = _mm_cmpeq_epi8(block, needle);
+        if constexpr (ElemSize == 2u) eq = _mm_cmpeq_epi16(block, needle);
+        if constexpr (ElemSize == 4u) eq = _mm_cmpeq_epi32(block, needle);
+        return (u32)_mm_movemask_epi8(eq);
+    }
+}
+
+template <u32 ElemSize>
+TARGET_AVX2 inline __m256i search_broadcast_avx2(u64 bits)
+{
+    if constexpr (ElemSize == 1u) return _mm256_set1_epi8((char)bits);
+    if constexpr (ElemSize == 2u) return _mm256_set1_epi16((short)bits);
+    if constexpr (ElemSize == 4u) return _mm256_set1_epi32((int)bits);
+    if constexpr (ElemSize == 8u) return _mm256_set1_epi64x((long long)bits);
+}
+
+template <u32 ElemSize>
+TARGET_AVX2 inline u32 search_match_mask_avx2(const void* data, __m256i needle)
+{
+    const __m256i block = _mm256_loadu_si256((const __m256i*)data);
+
+    __m256i eq;
+    if constexpr (ElemSize == 1u) eq = _mm256_cmpeq_epi8(block, needle);
+    if constexpr (ElemSize == 2u) eq = _mm256_cmpeq_epi16(block, needle);
+    if constexpr (ElemSize == 4u) eq = _mm256_cmpeq_epi32(block, needle);
+    if constexpr (ElemSize == 8u) eq = _mm256_cmpeq_epi64(block, needle);
+
+    return (u32)_mm256_movemask_epi8(eq);
+}
+
+template <typename T>
+inline i32 find_linear_tail(const T* data, u32 first, u32 num_elements,
+                            const T& element)
+{
+    for (u32 i = first; i < num_elements; i++)
+    {
+        if (data[i] == element)
+        {
+            return (i32)i;
+        }
+    }
+    return -1;
+}
+
+template <typename T>
+inline i32 find_linear_sse2(const T* data, u32 num_elements, const T& element)
+{
+    constexpr u32 ElemsPerVec = sizeof(__m128i) / sizeof(T);
+
+    const __m128i needle =
+        search_broadcast_sse2<sizeof(T)>(lane_bits(element));
+    const u32 num_simd = round_down(num_elements, ElemsPerVec);
+
+    u32 i = 0;
+    for (; i < num_simd; i += ElemsPerVec)
+    {
+        const u32 mask = search_match_mask_sse2<sizeof(T)>(&data[i], needle);
+        if (mask != 0u)
+        {
+            // movemask yields one bit per byte
+            return (i32)(i + Intrinsics::find_lsb(mask) / sizeof(T));
+        }
+    }
+    return find_linear_tail(data, i, num_elements, element);
+}
+
+template <typename T>
+TARGET_AVX2 inline i32 find_linear_avx2(const T* data, u32 num_elements,
+                                        const T& element)
+{
+    constexpr u32 ElemsPerVec = sizeof(__m256i) / sizeof(T);
+
+    const __m256i needle =
+        search_broadcast_avx2<sizeof(T)>(lane_bits(element));
+    const u32 num_simd = round_down(num_elements, ElemsPerVec);
+
+    u32 i = 0;
+    for (; i < num_simd; i += ElemsPerVec)
+    {
+        const u32 mask = search_match_mask_avx2<sizeof(T)>(&data[i], needle);
+        if (mask != 0u)
+        {
+            return (i32)(i + Intrinsics::find_lsb(mask) / sizeof(T));
+        }
+    }
+    return find_linear_tail(data, i, num_elements, element);
+}
+
+} // namespace Detail
+
+/*
+ * Equality search for integral, enum and pointer elements. Compares a full
+ * register of elements per iteration, 32 bytes on CPUs with AVX2 and 16
+ * (SSE2) otherwise, the tail is handled scalar.
+ */
+template <Detail::simd_searchable ArrayType>
+[[nodiscard]] inline i32 find_linear_simd(View<const ArrayType> container,
+                                          const ArrayType&      element)
+{
+    if (Intrinsics::cpu_features().avx2)
+    {
+        return Detail::find_linear_avx2(container.Data, container.NumElements,
+                                        element);
+    }
+    return Detail::find_linear_sse2(container.Data, container.NumElements,
+                                    element);
+}
+
 template <typename ArrayType, typename ElemType>
 [[nodiscard]] inline i32 find_linear(View<const ArrayType>&& container,
 	const ElemType& element)
 {
-	return find_linear(std::forward(container), element, EqualOp<void>());
+    if constexpr (Detail::simd_searchable<ArrayType> &&
+                  std::is_convertible_v<ElemType, ArrayType>)
+    {
+        return find_linear_simd<ArrayType>(container, (ArrayType)element);
+    }
+    else
+    {
+        return find_linear(std::move(container), element, EqualOp<void>());
+    }
+}
+
+/*
+ * Branchless binary search, the loop only has a conditional move so it does
+ * not suffer from mispredicts on random queries.
+ *
+ * Returns the index of the first element not less than value
+ * (NumElements if there is none).
+ */
+template <typename T, typename LessT = std::less<>>
+[[nodiscard]] inline u32 lower_bound(View<const T> sorted, const T& value,
+                                     LessT less = {})
+{
+    if (sorted.NumElements == 0u)
+    {
+        return 0u;
+    }
+
+    const T* base = sorted.Data;
+    u32      len  = sorted.NumElements;
+    while (len > 1u)
+    {
+        const u32 half = len / 2u;
+        base           = less(base[half - 1u], value) ? base + half : base;
+        len -= half;
+    }
+
+    return (u32)(base - sorted.Data) + (less(*base, value) ? 1u : 0u);
+}
+
+/*
+ * Returns the index of the first element greater than value
+ * (NumElements if there is none).
+ */
+template <typename T, typename LessT = std::less<>>
+[[nodiscard]] inline u32 upper_bound(View<const T> sorted, const T& value,
+                                     LessT less = {})
+{
+    if (sorted.NumElements == 0u)
+    {
+        return 0u;
+    }
+
+    const T* base = sorted.Data;
+    u32      len  = sorted.NumElements;
+    while (len > 1u)
+    {
+        const u32 half = len / 2u;
+        base           = !less(value, base[half - 1u]) ? base + half : base;
+        len -= half;
+    }
+
+    return (u32)(base - sorted.Data) + (!less(value, *base) ? 1u : 0u);
 }
+
+/*
+ * EytzingerArray
+ *
+ * Static sorted key set stored in BFS (eytzinger) order: the children of slot
+ * k live at 2k and 2k + 1. The first levels of the tree share cache lines and
+ * the next levels can be prefetched ahead, which makes lookups in large sets
+ * a lot cheaper than a binary search over the sorted array.
+ *
+ * Slot 0 is unused, lookups return the rank of the key in the sorted input so
+ * it can index parallel value arrays.
+ */
+template <typename T, typename LessT = std::less<>>
+class EytzingerArray final
+{
+    static constexpr u32 CacheLineSize = 64u;
+    // slots 4 levels down from k start at 16k, one line ahead covers them
+    static constexpr u32 PrefetchStride =
+        sizeof(T) < CacheLineSize ? CacheLineSize / sizeof(T) : 1u;
+
+  public:
+    T*   slots       = nullptr;
+    u32* ranks       = nullptr;
+    u32  NumElements = 0;
+
+    IAllocator&  _Allocator;
+    MemoryHandle slots_handle;
+    MemoryHandle ranks_handle;
+
+  public:
+    EytzingerArray(IAllocator& allocator, View<const T> sorted)
+        : NumElements(sorted.NumElements), _Allocator(allocator)
+    {
+        slots_handle = _Allocator.CreateArray<T, CacheLineSize>(
+            slots, NumElements + 1u);
+        ranks_handle = _Allocator.CreateArray<u32, CacheLineSize>(
+            ranks, NumElements + 1u);
+
+        build(sorted, 0u, 1u);
+    }
+
+    EytzingerArray(const EytzingerArray&) = delete;
+
+    ~EytzingerArray()
+    {
+        _Allocator.Free(slots_handle);
+        _Allocator.Free(ranks_handle);
+    }
+
+    u32 Size() const { return NumElements; }
+
+    /*
+     * Returns the slot of the first key not less than value, 0 if there is
+     * none.
+     */
+    [[nodiscard]] inline u32 lower_bound_slot(const T& value) const
+    {
+        LessT less;
+
+        u32 k = 1u;
+        while (k <= NumElements)
+        {
+            __builtin_prefetch(slots + k * PrefetchStride);
+            k = 2u * k + (less(slots[k], value) ? 1u : 0u);
+        }
+
+        // undo the trailing right turns plus the final left turn
+        k >>= Intrinsics::find_lsb(~k) + 1;
+        return k;
+    }
+
+    /*
+     * Sorted index of the first key not less than value, NumElements if none.
+     */
+    [[nodiscard]] inline u32 lower_bound(const T& value) const
+    {
+        const u32 slot = lower_bound_slot(value);
+        return slot != 0u ? ranks[slot] : NumElements;
+    }
+
+    /*
+     * Sorted index of value, -1 if it is not part of the set.
+     */
+    [[nodiscard]] inline i32 find(const T& value) const
+    {
+        LessT     less;
+        const u32 slot = lower_bound_slot(value);
+        if (slot != 0u && !less(value, slots[slot]))
+        {
+            return (i32)ranks[slot];
+        }
+        return -1;
+    }
+
+    [[nodiscard]] inline bool contains(const T& value) const
+    {
+        return find(value) >= 0;
+    }
+
+  private:
+    // in-order walk of the implicit tree assigns the sorted keys
+    u32 build(View<const T> sorted, u32 sorted_index, u32 k)
+    {
+        if (k <= NumElements)
+        {
+            sorted_index = build(sorted, sorted_index, 2u * k);
+            slots[k]     = sorted[sorted_index];
+            ranks[k]     = sorted_index++;
+            sorted_index = build(sorted, sorted_index, 2u * k + 1u);
+        }
+        return sorted_index;
+    }
+};
+
 } // namespace AE
@@ -0,0 +1,166 @@
+#pragma once
+
+#include "../Allocators.hpp"
+#include "../Containers.hpp"
+
+#include <cstring>
+#include <type_traits>
+
+namespace AE
+{
+
+namespace Detail
+{
+
+static constexpr u32 RADIX_BITS    = 8u;
+static constexpr u32 RADIX_BUCKETS = 1u << RADIX_BITS;
+static constexpr u32 RADIX_MASK    = RADIX_BUCKETS - 1u;
+
+template <typename KeyT>
+concept radix_key = std::is_integral_v<KeyT> &&
+                    (sizeof(KeyT) == sizeof(u32) || sizeof(KeyT) == sizeof(u64));
+
+// Maps the key to an unsigned value with the same ordering, signed keys get
+// their sign bit flipped so negative values sort first.
+template <radix_key KeyT>
+inline constexpr std::make_unsigned_t<KeyT> radix_bits(KeyT key)
+{
+    using UKeyT = std::make_unsigned_t<KeyT>;
+
+    UKeyT bits = (UKeyT)key;
+    if constexpr (std::is_signed_v<KeyT>)
+    {
+        bits ^= UKeyT(1) << (sizeof(KeyT) * 8u - 1u);
+    }
+    return bits;
+}
+
+template <radix_key KeyT, typename ValueT, bool WithValues, size_t _Alignment>
+inline void radix_sort_impl(KeyT* keys, ValueT* values, const u32 num_elements,
+                            ArenaAllocator<_Alignment>& scratch)
+{
+    constexpr u32 NumPasses = sizeof(KeyT) * 8u / RADIX_BITS;
+
+    if (num_elements < 2u)
+    {
+        return;
+    }
+
+    // Build the histograms of every digit in a single pass over the keys
+    u32 histograms[NumPasses][RADIX_BUCKETS] = {};
+    for (u32 i = 0; i < num_elements; i++)
+    {
+        const auto bits = radix_bits(keys[i]);
+        for (u32 pass = 0; pass < NumPasses; pass++)
+        {
+            histograms[pass][(bits >> (pass * RADIX_BITS)) & RADIX_MASK]++;
+        }
+    }
+
+    // Scratch memory only lives for the duration of the sort
+    const size_t scratch_offset = scratch.buffer_offset;
+
+    MemoryHandle key_memory = scratch.Allocate(
+        sizeof(KeyT) * num_elements, {true, alignof(KeyT)});
+    assert(key_memory.is_valid());
+
+    KeyT* keys_src = keys;
+    KeyT* keys_dst = static_cast<KeyT*>(scratch.HandleToPtr(key_memory));
+
+    ValueT* values_src = values;
+    ValueT* values_dst = nullptr;
+    if constexpr (WithValues)
+    {
+        MemoryHandle value_memory = scratch.Allocate(
+            sizeof(ValueT) * num_elements, {true, alignof(ValueT)});
+        assert(value_memory.is_valid());
+
+        values_dst = static_cast<ValueT*>(scratch.HandleToPtr(value_memory));
+    }
+
+    for (u32 pass = 0; pass < NumPasses; pass++)
+    {
+        const u32  shift     = pass * RADIX_BITS;
+        u32* const histogram = histograms[pass];
+
+        // every key shares this digit, the pass would not move anything
+        if (histogram[(radix_bits(keys_src[0]) >> shift) & RADIX_MASK] ==
+            num_elements)
+        {
+            continue;
+        }
+
+        // exclusive prefix sum into bucket offsets
+        u32 offset = 0u;
+        for (u32 bucket = 0; bucket < RADIX_BUCKETS; bucket++)
+        {
+            const u32 count   = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += count;
+        }
+
+        for (u32 i = 0; i < num_elements; i++)
+        {
+            const u32 digit =
+                (radix_bits(keys_src[i]) >> shift) & RADIX_MASK;
+            const u32 dst_index = histogram[digit]++;
+
+            keys_dst[dst_index] = keys_src[i];
+            if constexpr (WithValues)
+            {
+                values_dst[dst_index] = values_src[i];
+            }
+        }
+
+        std::swap(keys_src, keys_dst);
+        if constexpr (WithValues)
+        {
+            std::swap(values_src, values_dst);
+        }
+    }
+
+    // odd number of scattering passes, result lives in the scratch buffers
+    if (keys_src != keys)
+    {
+        memcpy(keys, keys_src, sizeof(KeyT) * num_elements);
+        if constexpr (WithValues)
+        {
+            memcpy(values, values_src, sizeof(ValueT) * num_elements);
+        }
+    }
+
+    scratch.buffer_offset = scratch_offset;
+}
+
+} // namespace Detail
+
+/*
+ * Stable LSD radix sort (8 bit digits) of 32 or 64 bit integer keys.
+ *
+ * Needs num_elements keys of scratch space in the given arena, which is
+ * released again before returning. Passes where all keys share the same digit
+ * are skipped.
+ */
+template <Detail::radix_key KeyT, size_t _Alignment>
+inline void radix_sort(View<KeyT> keys, ArenaAllocator<_Alignment>& scratch)
+{
+    Detail::radix_sort_impl<KeyT, u8, false>(keys.Data, nullptr,
+                                             keys.NumElements, scratch);
+}
+
+/*
+ * Key/value variant: values are permuted along with their keys.
+ * ValueT must be trivially copyable (e.g. an index or handle).
+ */
+template <Detail::radix_key KeyT, typename ValueT, size_t _Alignment>
+    requires std::is_trivially_copyable_v<ValueT>
+inline void radix_sort(View<KeyT> keys, View<ValueT> values,
+                       ArenaAllocator<_Alignment>& scratch)
+{
+    assert(keys.NumElements == values.NumElements);
+
+    Detail::radix_sort_impl<KeyT, ValueT, true>(keys.Data, values.Data,
+                                                keys.NumElements, scratch);
+}
+
+} // namespace AE
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
@@ -81,7 +82,7 @@ class IAllocator
     virtual void                       Free(const MemoryHandle& handle) = 0;
     virtual void                       FreeAll()                        = 0;
     virtual size_t                     GetSize() const                  = 0;
-    virtual void  GetRawData(void* out_data, u32* out_size)             = 0;
+    virtual void  GetRawData(void*& out_data, u32* out_size)            = 0;
     virtual void* HandleToPtr(const MemoryHandle& handle)               = 0;
 
     template <typename T>
@@ -117,7 +118,7 @@ class IAllocator
 
     template <typename T, size_t _Alignment = alignof(T), class... Args>
         requires std::is_constructible_v<T, Args...>
-    [[nodiscard]] constexpr MemoryHandle CreateArray(T*& out_obj, const u32 N,
+    [[nodiscard]] constexpr MemoryHandle CreateArray(T*& out_obj, const size_t N,
                                                      Args&&... args)
     {
         out_obj            = nullptr;
@@ -143,7 +144,7 @@ class IAllocator
             // array
             T* base_address = static_cast<T*>(HandleToPtr(handle));
             uintptr_t address = reinterpret_cast<uintptr_t>(base_address);
-            for (u32 i = 0; i < N; i++)
+            for (size_t i = 0; i < N; i++)
             {
                 ::new (reinterpret_cast<void*>(address)) T(args...);
                 // address += element_size;
@@ -190,7 +191,7 @@ class ArenaAllocator final : public IAllocatorTempl<true>
 
     void GetRawData(void*& out_data, u32* out_size) override
     {
-        assert(out_data != nullptr);
+        assert(out_size != nullptr);
         out_data  = buffer;
         *out_size = static_cast<u32>(buffer_offset);
     }
@@ -241,6 +242,84 @@ class ArenaAllocator final : public IAllocatorTempl<true>
     void FreeAll() override { buffer_offset = 0; };
 };
 
+/*
+ * HeapAllocator
+ *
+ * Every allocation is its own malloc, Free gives it back. For long lived
+ * containers that keep growing (global tables) where an arena would leak
+ * every outgrown copy and eventually run out.
+ */
+class HeapAllocator final : public IAllocatorTempl<false>
+{
+  public:
+    size_t allocated_bytes = 0;
+
+  public:
+    [[nodiscard]] constexpr HeapAllocator() = default;
+
+    // Blocks are separate mallocs, there is no single buffer to hand out.
+    void GetRawData(void*& out_data, u32* out_size) override
+    {
+        out_data  = nullptr;
+        *out_size = 0u;
+    }
+
+    void* HandleToPtr(const MemoryHandle& handle) override
+    {
+        if (!handle.is_valid() || handle.owningAllocator != this)
+        {
+            return nullptr;
+        }
+
+        return (void*)(uintptr_t)handle.offset;
+    }
+
+    void Init(size_t) override {}
+
+    [[nodiscard]] MemoryHandle Allocate(size_t        Size,
+                                        AllocParams&& params) override
+    {
+        // room to align and to keep the malloc'd pointer in front of the
+        // aligned block
+        const size_t alignment =
+            std::max<size_t>(params.Alignment, sizeof(void*));
+
+        u8* raw = static_cast<u8*>(malloc(Size + alignment + sizeof(void*)));
+        if (raw == nullptr)
+        {
+            // OUT OF MEMORY
+            return IAllocator::InvalidHandle;
+        }
+
+        const uintptr_t aligned = MemoryUtils::align_forward(
+            (uintptr_t)raw + sizeof(void*), alignment);
+        memcpy((void*)(aligned - sizeof(void*)), &raw, sizeof(void*));
+        memset((void*)aligned, 0, Size);
+
+        allocated_bytes += Size;
+        return {.owningAllocator = this, .offset = (u64)aligned, .size = Size};
+    }
+
+    void Free(const MemoryHandle& handle) override
+    {
+        if (!handle.is_valid() || handle.owningAllocator != this)
+        {
+            return;
+        }
+
+        void* raw;
+        memcpy(&raw, (const void*)(uintptr_t)(handle.offset - sizeof(void*)),
+               sizeof(void*));
+        free(raw);
+        allocated_bytes -= handle.size;
+    }
+
+    // allocations aren't tracked, they are freed one by one
+    void FreeAll() override {}
+
+    size_t GetSize() const override { return allocated_bytes; }
+};
+
 // class LinearBlockAllocator final : public IAllocatorTempl<true>
 // {
 //   public:
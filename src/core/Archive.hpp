@@ -0,0 +1,464 @@
+#pragma once
+
+#include "Allocators.hpp"
+#include "BitList.hpp"
+#include "Containers.hpp"
+#include "PerfectHash.hpp"
+#include "Pool.hpp"
+#include "core.hpp"
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+
+/*
+ * Relocatable binary archives
+ *
+ * Containers are written to a single blob in which every pointer is replaced
+ * by a self relative offset (RelPtr). The blob doesn't depend on the address
+ * it is loaded at, so loading is one read of the file followed by a header
+ * check, after which the archived types are used in place without parsing.
+ *
+ *  struct LevelData
+ *  {
+ *      using archived_types = ArchiveTypes<ArchivedArray<Vertex>,
+ *                                          ArchivedPool<Texture, TextureHandle>>;
+ *
+ *      ArchivedArray<Vertex>               vertices;
+ *      ArchivedPool<Texture, TextureHandle> textures;
+ *  };
+ *
+ *  ArchiveWriter writer(allocator, LEVEL_VERSION);
+ *  const u64 root = writer.reserve<LevelData>();
+ *  writer.write_array(root + offsetof(LevelData, vertices), vertex_view);
+ *  writer.write_pool(root + offsetof(LevelData, textures), texture_pool);
+ *  View<const u8> blob = writer.finish<LevelData>(root);
+ *
+ *  const LevelData* level = archive_root<LevelData>(blob, LEVEL_VERSION);
+ *
+ * Archived element types are copied bytewise and must be trivially copyable
+ * (a StaticArray of those can be written with write_value).
+ *
+ * The header holds a hash of the root type's layout, which includes the
+ * types it lists in archived_types, recursively (ArchivedArray and
+ * ArchivedPool list their element types). Root types must list the type of
+ * every archived member, so a changed Vertex inside ArchivedArray<Vertex>
+ * makes loading fail instead of reading garbage.
+ */
+
+/*
+ * Types stored behind the pointers of an archived type, see
+ * archive_layout_hash.
+ */
+template <typename... Ts>
+struct ArchiveTypes
+{
+};
+
+/*
+ * Offset based pointer, relative to its own address. 0 is null.
+ */
+template <typename T>
+struct RelPtr
+{
+    using archived_types = ArchiveTypes<T>;
+
+    i64 offset = 0;
+
+    RelPtr()              = default;
+    RelPtr(const RelPtr&) = delete; // a copy would point somewhere else
+
+    inline const T* get() const
+    {
+        if (offset == 0)
+        {
+            return nullptr;
+        }
+        return reinterpret_cast<const T*>(reinterpret_cast<const u8*>(this) +
+                                          offset);
+    }
+
+    inline const T* operator->() const { return get(); }
+};
+
+template <typename T>
+struct ArchivedArray
+{
+    using archived_types = ArchiveTypes<T>;
+
+    RelPtr<T> data;
+    u32       num_elements = 0u;
+
+    inline View<const T> view() const
+    {
+        View<const T> Result = {.Data = data.get(), .NumElements = num_elements};
+        return Result;
+    }
+
+    inline const T& operator[](const u32 index) const
+    {
+        assert(index < num_elements);
+        return data.get()[index];
+    }
+
+    inline u32 Size() const { return num_elements; }
+};
+
+/*
+ * Archived Pool, readable in place. The freelist chunks match
+ * Pool::freelist (DynamicBitlist<64u>).
+ */
+template <typename T, typename PoolHandleT>
+struct ArchivedPool
+{
+    using FreelistChunk  = BitList<64u>;
+    using archived_types = ArchiveTypes<T, FreelistChunk>;
+
+    ArchivedArray<u32>           generations;
+    ArchivedArray<FreelistChunk> freelist;
+    ArchivedArray<T>             objects;
+
+    inline bool is_handle_valid(const PoolHandleT& handle) const
+    {
+        const u32 index = handle.index;
+        return index > 0 && index < generations.Size() &&
+               handle.gen == generations[index];
+    }
+
+    inline const T& get_element(const PoolHandleT& handle) const
+    {
+        assert(is_handle_valid(handle));
+        return objects[handle.index];
+    }
+
+    /*
+     * Copies the archived state into a live pool, one memcpy per array.
+     * Deferred removals still pending in the pool refer to slots of the
+     * replaced state and are dropped.
+     */
+    void load_into(Pool<T, PoolHandleT>& pool) const
+    {
+        pool.pending_removals.NumElements = 0u;
+
+        // every loaded element is new to whoever consumes the dirty slots,
+        // and slots used before the load may be free now: both are dirty
+        pool.dirty.resize(std::max(pool.freelist.total_capacity,
+                                   freelist.Size() * FreelistChunk::NumBits));
+        for (u32 i = 0; i < pool.freelist.num_chunks(); i++)
+        {
+            bitlist_or(pool.dirty.chunks[i], pool.dirty.chunks[i],
+                       pool.freelist.chunks[i]);
+        }
+        for (u32 i = 0; i < freelist.Size(); i++)
+        {
+            bitlist_or(pool.dirty.chunks[i], pool.dirty.chunks[i], freelist[i]);
+        }
+        pool.dirty.chunks[0].unset_bit(0u); // the null slot
+        pool.dirty.rebuild_summaries();
+
+        load_array(generations, pool.generations);
+        load_array(freelist, pool.freelist.chunks);
+        load_array(objects, pool.objects);
+
+        pool.freelist.total_capacity =
+            freelist.Size() * DynamicBitlist<64u>::BitsPerChunk;
+        pool.freelist.rebuild_summaries();
+    }
+
+  private:
+    template <typename ElemT>
+    static void load_array(const ArchivedArray<ElemT>& src, Array<ElemT>& dst)
+    {
+        dst.NumElements = 0u;
+        if (src.Size() > 0u)
+        {
+            dst.add_no_init(src.Size());
+            memcpy(dst.Data, src.data.get(), src.Size() * sizeof(ElemT));
+        }
+    }
+};
+
+struct ArchiveHeader
+{
+    static constexpr u32 Magic = 0x48435241u; // "ARCH"
+
+    u32 magic;
+    u32 version;
+    u64 layout_hash;
+    u64 size;
+    u64 root_offset;
+    u32 max_alignment;
+    u32 _pad;
+};
+
+namespace Detail
+{
+
+// Name, size and alignment of a single type
+template <typename T>
+consteval u64 archive_type_hash()
+{
+    const u64 name_hash = static_hash(std::string_view(__PRETTY_FUNCTION__));
+    return name_hash ^ static_hash(((u64)sizeof(T) << 32) | alignof(T));
+}
+
+} // namespace Detail
+
+template <typename T>
+consteval u64 archive_layout_hash();
+
+template <typename... Ts>
+consteval u64 archive_layout_hash(ArchiveTypes<Ts...>)
+{
+    u64 result = 0u;
+    ((result = Detail::static_hash(result ^ archive_layout_hash<Ts>())), ...);
+    return result;
+}
+
+/*
+ * Hash of the type's name, size and alignment, combined with the layout
+ * hashes of the types in T::archived_types. Layout changes that keep the
+ * names and sizes (e.g. swapping two u32 members) aren't caught, bump the
+ * archive version for those. Types that (indirectly) point to themselves
+ * can't list themselves.
+ */
+template <typename T>
+consteval u64 archive_layout_hash()
+{
+    u64 result = Detail::archive_type_hash<T>();
+    if constexpr (requires { typename T::archived_types; })
+    {
+        result = Detail::static_hash(
+            result ^ archive_layout_hash(typename T::archived_types{}));
+    }
+    return result;
+}
+
+template <typename T>
+concept ArchiveRoot = requires { typename T::archived_types; };
+
+class ArchiveWriter final
+{
+  public:
+    Array<u8> buffer;
+    u32       version;
+    u32       max_alignment = alignof(ArchiveHeader);
+
+  public:
+    explicit ArchiveWriter(IAllocator& allocator, u32 version,
+                           u32 reservedBytes = KB(64))
+        : buffer(allocator, reservedBytes), version(version)
+    {
+        reserve<ArchiveHeader>();
+    }
+
+    /*
+     * Appends zeroed, aligned room for count T's, returns its offset.
+     */
+    template <typename T>
+    u64 reserve(u32 count = 1u)
+    {
+        return reserve_bytes(sizeof(T) * count, alignof(T));
+    }
+
+    template <typename T>
+        requires std::is_trivially_copyable_v<T>
+    void write_value(u64 offset, const T& value)
+    {
+        assert(offset + sizeof(T) <= buffer.NumElements);
+        memcpy(&buffer.Data[offset], &value, sizeof(T));
+    }
+
+    /*
+     * Points the RelPtr stored at rel_ptr_offset to target_offset.
+     */
+    void link(u64 rel_ptr_offset, u64 target_offset)
+    {
+        const i64 relative = (i64)target_offset - (i64)rel_ptr_offset;
+        write_value(rel_ptr_offset, relative);
+    }
+
+    /*
+     * Copies the elements into the archive and fills in the ArchivedArray
+     * stored at array_offset.
+     */
+    template <typename T>
+        requires std::is_trivially_copyable_v<T>
+    void write_array(u64 array_offset, View<const T> elems)
+    {
+        using ArchivedT = ArchivedArray<T>;
+
+        write_value(array_offset + offsetof(ArchivedT, num_elements),
+                    elems.NumElements);
+        if (elems.NumElements == 0u)
+        {
+            return;
+        }
+
+        const u64 data_offset = reserve<T>(elems.NumElements);
+        memcpy(&buffer.Data[data_offset], elems.Data,
+               sizeof(T) * elems.NumElements);
+
+        link(array_offset + offsetof(ArchivedT, data), data_offset);
+    }
+
+    /*
+     * Slots of deferred removals that haven't been released yet are written
+     * as free, their handles are already invalid.
+     */
+    template <typename T, typename PoolHandleT>
+    void write_pool(u64 pool_offset, Pool<T, PoolHandleT>& pool)
+    {
+        using ArchivedT     = ArchivedPool<T, PoolHandleT>;
+        using FreelistChunk = typename ArchivedT::FreelistChunk;
+
+        write_array(pool_offset + offsetof(ArchivedT, generations),
+                    CreateConstView(pool.generations));
+        write_array(pool_offset + offsetof(ArchivedT, freelist),
+                    CreateConstView(pool.freelist.chunks));
+        write_array(pool_offset + offsetof(ArchivedT, objects),
+                    CreateConstView(pool.objects));
+
+        if (pool.pending_removals.NumElements == 0u)
+        {
+            return;
+        }
+
+        const u64 rel_ptr_offset = pool_offset + offsetof(ArchivedT, freelist) +
+                                   offsetof(ArchivedArray<FreelistChunk>, data);
+        i64 relative;
+        memcpy(&relative, &buffer.Data[rel_ptr_offset], sizeof(i64));
+        const u64 freelist_offset = rel_ptr_offset + relative;
+
+        for (u32 i = 0; i < pool.pending_removals.NumElements; i++)
+        {
+            const u32 index    = pool.pending_removals[i].index;
+            const u64 chunk_at = freelist_offset + (index / FreelistChunk::NumBits) *
+                                                       sizeof(FreelistChunk);
+
+            FreelistChunk chunk;
+            memcpy(&chunk, &buffer.Data[chunk_at], sizeof(FreelistChunk));
+            chunk.unset_bit(index % FreelistChunk::NumBits);
+            memcpy(&buffer.Data[chunk_at], &chunk, sizeof(FreelistChunk));
+        }
+    }
+
+    /*
+     * Fills in the header, the returned blob lives in the writer's buffer.
+     */
+    template <ArchiveRoot RootT>
+    View<const u8> finish(u64 root_offset)
+    {
+        const ArchiveHeader header = {
+            .magic         = ArchiveHeader::Magic,
+            .version       = version,
+            .layout_hash   = archive_layout_hash<RootT>(),
+            .size          = buffer.NumElements,
+            .root_offset   = root_offset,
+            .max_alignment = max_alignment,
+            ._pad          = 0u,
+        };
+        write_value(0u, header);
+
+        View<const u8> Result = {.Data        = buffer.Data,
+                                 .NumElements = buffer.NumElements};
+        return Result;
+    }
+
+  private:
+    u64 reserve_bytes(u64 size, u32 alignment)
+    {
+        max_alignment = std::max(max_alignment, alignment);
+
+        const u64 offset  = round_to<u64>(buffer.NumElements, alignment);
+        const u32 padding = (u32)(offset - buffer.NumElements);
+
+        const u32 first_new = buffer.NumElements;
+        buffer.add_no_init(padding + (u32)size);
+        memset(&buffer.Data[first_new], 0, padding + size);
+
+        return offset;
+    }
+};
+
+/*
+ * Validates the blob and returns its root, nullptr if the blob was written
+ * for another version or layout, is truncated, or isn't aligned enough to be
+ * used in place.
+ */
+template <ArchiveRoot RootT>
+const RootT* archive_root(View<const u8> blob, u32 version)
+{
+    if (blob.NumElements < sizeof(ArchiveHeader))
+    {
+        return nullptr;
+    }
+
+    const ArchiveHeader* header =
+        reinterpret_cast<const ArchiveHeader*>(blob.Data);
+
+    if (header->magic != ArchiveHeader::Magic || header->version != version ||
+        header->layout_hash != archive_layout_hash<RootT>() ||
+        header->size > blob.NumElements ||
+        header->root_offset + sizeof(RootT) > header->size ||
+        ((uintptr_t)blob.Data & (header->max_alignment - 1u)) != 0u)
+    {
+        return nullptr;
+    }
+
+    return reinterpret_cast<const RootT*>(blob.Data + header->root_offset);
+}
+
+/*
+ * Reads a whole archive file with a single read into cache line aligned
+ * memory from the allocator. Returns an empty view on failure.
+ */
+inline View<const u8> archive_read_file(const char* path, IAllocator& allocator,
+                                        MemoryHandle& out_handle)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr)
+    {
+        return {.Data = nullptr, .NumElements = 0u};
+    }
+
+    fseek(file, 0, SEEK_END);
+    const long file_size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    u8*  data = nullptr;
+    bool read = false;
+    if (file_size > 0)
+    {
+        out_handle = allocator.Allocate((size_t)file_size, {true, 64u});
+        if (out_handle.is_valid())
+        {
+            data = static_cast<u8*>(allocator.HandleToPtr(out_handle));
+            read = fread(data, 1, (size_t)file_size, file) == (size_t)file_size;
+        }
+    }
+
+    fclose(file);
+
+    if (!read)
+    {
+        return {.Data = nullptr, .NumElements = 0u};
+    }
+    return {.Data = data, .NumElements = (u32)file_size};
+}
+
+inline bool archive_write_file(const char* path, View<const u8> blob)
+{
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    const bool written =
+        fwrite(blob.Data, 1, blob.NumElements, file) == blob.NumElements;
+    fclose(file);
+    return written;
+}
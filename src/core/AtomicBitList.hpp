@@ -0,0 +1,234 @@
+#pragma once
+
+#include "Allocators.hpp"
+#include "core.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <new>
+
+/*
+ * Lock free slot allocation
+ *
+ * Bit sets of std::atomic<u64> words that worker threads claim and release
+ * slots from without a mutex (descriptor indices, pool slots, staging
+ * blocks). Same convention as BitList: 0 is a free slot, 1 is taken.
+ *
+ *  try_set(i)              claims slot i, false if it was already taken
+ *  unset_bit(i)            releases slot i
+ *  claim_first_free(hint)  claims the first free slot at or after hint
+ *                          (wrapping around), -1 if all slots are taken
+ *
+ * Threads that all search from 0 fight over the same first words. Giving
+ * every thread its own start hint (thread_hint()) spreads them over
+ * different cache lines, so they mostly claim without contention.
+ *
+ * Claims are acquire and releases are release: whatever the previous owner
+ * of a slot wrote before unset_bit is visible to the next one that claims it.
+ */
+namespace Detail
+{
+
+inline u64 atomic_bits_word_mask(u32 word_index, u32 num_words, u32 num_bits)
+{
+    const u32 tail_bits = num_bits % 64u;
+    return word_index + 1u == num_words && tail_bits != 0u
+               ? (1ull << tail_bits) - 1ull
+               : ~0ull;
+}
+
+inline bool atomic_bits_try_set(std::atomic<u64>* words, u32 index)
+{
+    const u64 bit = 1ull << (index % 64u);
+    return (words[index / 64u].fetch_or(bit, std::memory_order_acq_rel) & bit) ==
+           0u;
+}
+
+inline void atomic_bits_unset(std::atomic<u64>* words, u32 index)
+{
+    const u64 bit = 1ull << (index % 64u);
+
+    [[maybe_unused]] const u64 prev =
+        words[index / 64u].fetch_and(~bit, std::memory_order_release);
+    assert((prev & bit) && "releasing a slot that wasn't taken");
+}
+
+inline bool atomic_bits_test(const std::atomic<u64>* words, u32 index)
+{
+    return (words[index / 64u].load(std::memory_order_acquire) >> (index % 64u)) &
+           1u;
+}
+
+/*
+ * Claims the lowest free bit of every word with a CAS, starting at the
+ * hint's word. A failed CAS reloads the word, so another thread taking a
+ * bit of the same word only costs a retry on the bits that are left.
+ */
+inline i32 atomic_bits_claim(std::atomic<u64>* words, u32 num_words,
+                             u32 num_bits, u32 start_hint)
+{
+    if (num_words == 0u)
+    {
+        return -1;
+    }
+
+    const u32 first_word = (start_hint / 64u) % num_words;
+    for (u32 i = 0; i < num_words; i++)
+    {
+        u32 w = first_word + i;
+        w     = w >= num_words ? w - num_words : w;
+
+        const u64 valid = atomic_bits_word_mask(w, num_words, num_bits);
+
+        u64 word = words[w].load(std::memory_order_relaxed);
+        while ((~word & valid) != 0u)
+        {
+            const u64 bit = (~word & valid) & (0ull - (~word & valid));
+            if (words[w].compare_exchange_weak(word, word | bit,
+                                               std::memory_order_acq_rel,
+                                               std::memory_order_relaxed))
+            {
+                return (i32)(w * 64u + (u32)__builtin_ctzll(bit));
+            }
+        }
+    }
+    return -1;
+}
+
+inline u32 atomic_bits_count(const std::atomic<u64>* words, u32 num_words)
+{
+    u32 Result = 0u;
+    for (u32 w = 0; w < num_words; w++)
+    {
+        Result += (u32)__builtin_popcountll(words[w].load(std::memory_order_relaxed));
+    }
+    return Result;
+}
+
+// 8 words (512 bits) per cache line
+inline u32 atomic_bits_thread_hint(u32 num_words, u32 thread_index,
+                                   u32 num_threads)
+{
+    assert(num_threads > 0u);
+    const u32 num_lines = (num_words + 7u) / 8u;
+    return (u32)((u64)thread_index * num_lines / num_threads) * 8u * 64u;
+}
+
+} // namespace Detail
+
+template <u32 N>
+struct AtomicBitList final
+{
+    static constexpr u32 NumWords = (N + 63u) / 64u;
+
+  public:
+    alignas(64) std::atomic<u64> words[NumWords] = {};
+
+  public:
+    AtomicBitList()                                = default;
+    AtomicBitList(const AtomicBitList&)            = delete;
+    AtomicBitList& operator=(const AtomicBitList&) = delete;
+
+    inline bool try_set(u32 index)
+    {
+        assert(index < N);
+        return Detail::atomic_bits_try_set(words, index);
+    }
+
+    inline void unset_bit(u32 index)
+    {
+        assert(index < N);
+        Detail::atomic_bits_unset(words, index);
+    }
+
+    inline bool operator[](u32 index) const
+    {
+        assert(index < N);
+        return Detail::atomic_bits_test(words, index);
+    }
+
+    inline i32 claim_first_free(u32 start_hint = 0u)
+    {
+        return Detail::atomic_bits_claim(words, NumWords, N, start_hint);
+    }
+
+    // Not a snapshot while other threads claim or release
+    inline u32 count() const { return Detail::atomic_bits_count(words, NumWords); }
+
+    inline u32 thread_hint(u32 thread_index, u32 num_threads) const
+    {
+        return Detail::atomic_bits_thread_hint(NumWords, thread_index, num_threads);
+    }
+};
+
+/*
+ * Runtime sized variant. The size is fixed at creation: growing would move
+ * the words under the threads using them, so callers that need more slots
+ * create a bigger set while no thread is using it.
+ */
+class AtomicDynamicBitlist final
+{
+  public:
+    std::atomic<u64>* words     = nullptr;
+    u32               num_words = 0u;
+    u32               num_bits  = 0u;
+
+    IAllocator&  _Allocator;
+    MemoryHandle memory_handle;
+
+  public:
+    AtomicDynamicBitlist(IAllocator& allocator, u32 num_bits)
+        : num_words((num_bits + 63u) / 64u), num_bits(num_bits),
+          _Allocator(allocator)
+    {
+        if (num_words == 0u)
+        {
+            return;
+        }
+
+        memory_handle =
+            _Allocator.Allocate(num_words * sizeof(std::atomic<u64>), {true, 64u});
+        assert(memory_handle.is_valid());
+
+        words = static_cast<std::atomic<u64>*>(_Allocator.HandleToPtr(memory_handle));
+        for (u32 w = 0; w < num_words; w++)
+        {
+            new (&words[w]) std::atomic<u64>(0u);
+        }
+    }
+
+    AtomicDynamicBitlist(const AtomicDynamicBitlist&)            = delete;
+    AtomicDynamicBitlist& operator=(const AtomicDynamicBitlist&) = delete;
+
+    ~AtomicDynamicBitlist() { _Allocator.Free(memory_handle); }
+
+    inline bool try_set(u32 index)
+    {
+        assert(index < num_bits);
+        return Detail::atomic_bits_try_set(words, index);
+    }
+
+    inline void unset_bit(u32 index)
+    {
+        assert(index < num_bits);
+        Detail::atomic_bits_unset(words, index);
+    }
+
+    inline bool operator[](u32 index) const
+    {
+        assert(index < num_bits);
+        return Detail::atomic_bits_test(words, index);
+    }
+
+    inline i32 claim_first_free(u32 start_hint = 0u)
+    {
+        return Detail::atomic_bits_claim(words, num_words, num_bits, start_hint);
+    }
+
+    inline u32 count() const { return Detail::atomic_bits_count(words, num_words); }
+
+    inline u32 thread_hint(u32 thread_index, u32 num_threads) const
+    {
+        return Detail::atomic_bits_thread_hint(num_words, thread_index, num_threads);
+    }
+};
@@ -0,0 +1,517 @@
+#pragma once
+
+#include "Algorithms/Search.hpp"
+#include "Allocators.hpp"
+#include "Containers.hpp"
+#include "core.hpp"
+
+#include <cstring>
+#include <functional>
+#include <type_traits>
+
+/*
+ * BTree
+ *
+ * B+tree map, all entries live in the leaves which are linked in key order.
+ * Nodes are NodeSize bytes (a multiple of a cache line) and are stored by
+ * index in SegmentedArrays, so the nodes themselves are allocated in chunks
+ * from the IAllocator and never move.
+ *
+ * Remove does not rebalance: leaves may end up under-full or empty, which
+ * keeps every separator key valid. BulkLoad rebuilds a compact tree.
+ *
+ * Keys and values must be trivially copyable.
+ */
+template <typename K, typename V, u32 NodeSize = 256u,
+          typename LessT = std::less<>>
+    requires std::is_trivially_copyable_v<K> &&
+             std::is_trivially_copyable_v<V> && (NodeSize % 64u == 0u)
+class BTree final
+{
+  public:
+    static constexpr u32 InvalidNode = ~0u;
+    static constexpr u32 MaxDepth    = 32u;
+
+    // leaf: count + next + keys/values
+    static constexpr u32 LeafCapacity =
+        (NodeSize - std::max<u32>(2u * sizeof(u32), alignof(K))) /
+        (sizeof(K) + sizeof(V));
+    // inner: count + keys + (keys + 1) children
+    static constexpr u32 InnerCapacity =
+        (NodeSize - std::max<u32>(sizeof(u32), alignof(K)) - sizeof(u32)) /
+        (sizeof(K) + sizeof(u32));
+
+    static_assert(LeafCapacity >= 2u && InnerCapacity >= 2u,
+                  "NodeSize too small for the key/value types");
+
+    struct alignas(64) LeafNode
+    {
+        u32 count = 0u;
+        u32 next  = InvalidNode;
+        K   keys[LeafCapacity];
+        V   values[LeafCapacity];
+    };
+
+    struct alignas(64) InnerNode
+    {
+        u32 count = 0u; // number of keys, children = count + 1
+        K   keys[InnerCapacity];
+        u32 children[InnerCapacity + 1u];
+    };
+
+    static_assert(sizeof(LeafNode) == NodeSize &&
+                  sizeof(InnerNode) == NodeSize);
+
+  public:
+    SegmentedArray<LeafNode, 256u> leaves;
+    SegmentedArray<InnerNode, 64u> inners;
+
+    u32 root        = InvalidNode;
+    u32 height      = 0u; // number of inner levels above the leaves
+    u32 first_leaf  = InvalidNode;
+    u32 NumElements = 0u;
+
+  public:
+    explicit BTree(IAllocator& allocator) : leaves(allocator), inners(allocator)
+    {
+        Clear();
+    }
+
+    BTree(const BTree&) = delete;
+
+    u32 Size() const { return NumElements; }
+
+    void Clear()
+    {
+        leaves.Clear();
+        inners.Clear();
+
+        root        = new_leaf();
+        first_leaf  = root;
+        height      = 0u;
+        NumElements = 0u;
+    }
+
+    [[nodiscard]] V* Get(const K& key)
+    {
+        LeafNode& leaf = leaves[find_leaf(key)];
+
+        const u32 pos = leaf_lower_bound(leaf, key);
+        if (pos < leaf.count && is_equal(leaf.keys[pos], key))
+        {
+            return &leaf.values[pos];
+        }
+        return nullptr;
+    }
+
+    [[nodiscard]] const V* Get(const K& key) const
+    {
+        return const_cast<BTree*>(this)->Get(key);
+    }
+
+    [[nodiscard]] bool Contains(const K& key) const
+    {
+        return Get(key) != nullptr;
+    }
+
+    /*
+     * Inserts or overwrites the value of key. Returns true if the key was new.
+     */
+    bool Insert(const K& key, const V& value)
+    {
+        u32 path_nodes[MaxDepth];
+        u32 path_slots[MaxDepth];
+
+        u32 node_id = root;
+        for (u32 level = 0; level < height; level++)
+        {
+            const InnerNode& inner = inners[node_id];
+            const u32        slot  = inner_child_slot(inner, key);
+
+            path_nodes[level] = node_id;
+            path_slots[level] = slot;
+            node_id           = inner.children[slot];
+        }
+
+        LeafNode& leaf = leaves[node_id];
+        const u32 pos  = leaf_lower_bound(leaf, key);
+        if (pos < leaf.count && is_equal(leaf.keys[pos], key))
+        {
+            leaf.values[pos] = value;
+            return false;
+        }
+
+        NumElements++;
+
+        if (leaf.count < LeafCapacity)
+        {
+            insert_at(leaf.keys, leaf.count, pos, key);
+            insert_at(leaf.values, leaf.count, pos, value);
+            leaf.count++;
+            return true;
+        }
+
+        // Split the leaf, the upper half moves to a new right sibling
+        K   separator;
+        u32 new_node_id = split_leaf(node_id, pos, key, value, separator);
+
+        // Propagate the new separator up the path
+        for (i32 level = (i32)height - 1; level >= 0; level--)
+        {
+            const u32  inner_id = path_nodes[level];
+            const u32  slot     = path_slots[level];
+            InnerNode& inner    = inners[inner_id];
+
+            if (inner.count < InnerCapacity)
+            {
+                insert_at(inner.keys, inner.count, slot, separator);
+                insert_at(inner.children, inner.count + 1u, slot + 1u,
+                          new_node_id);
+                inner.count++;
+                return true;
+            }
+
+            new_node_id = split_inner(inner_id, slot, separator, new_node_id,
+                                      separator);
+        }
+
+        // The root was split, grow the tree by one level
+        const u32  new_root_id = new_inner();
+        InnerNode& new_root    = inners[new_root_id];
+        new_root.count         = 1u;
+        new_root.keys[0]       = separator;
+        new_root.children[0]   = root;
+        new_root.children[1]   = new_node_id;
+
+        root = new_root_id;
+        height++;
+
+        return true;
+    }
+
+    bool Remove(const K& key)
+    {
+        LeafNode& leaf = leaves[find_leaf(key)];
+
+        const u32 pos = leaf_lower_bound(leaf, key);
+        if (pos >= leaf.count || !is_equal(leaf.keys[pos], key))
+        {
+            return false;
+        }
+
+        remove_at(leaf.keys, leaf.count, pos);
+        remove_at(leaf.values, leaf.count, pos);
+        leaf.count--;
+        NumElements--;
+        return true;
+    }
+
+    /*
+     * Replaces the content with already sorted, unique keys. Leaves are
+     * filled completely and the inner levels are built bottom up.
+     */
+    void BulkLoad(View<const K> sorted_keys, View<const V> sorted_values)
+    {
+        assert(sorted_keys.NumElements == sorted_values.NumElements);
+
+        leaves.Clear();
+        inners.Clear();
+
+        NumElements = sorted_keys.NumElements;
+        height      = 0u;
+
+        // Leaf level
+        u32 num_level_nodes = 0u;
+        u32 prev_leaf       = InvalidNode;
+        for (u32 i = 0; i < NumElements || num_level_nodes == 0u;
+             i += LeafCapacity)
+        {
+            const u32 leaf_id = new_leaf();
+            LeafNode& leaf    = leaves[leaf_id];
+            leaf.count        = std::min(LeafCapacity, NumElements - i);
+
+            // An empty input still builds one empty leaf, but its Data may
+            // be null.
+            if (leaf.count > 0u)
+            {
+                memcpy(leaf.keys, &sorted_keys.Data[i], leaf.count * sizeof(K));
+                memcpy(leaf.values, &sorted_values.Data[i],
+                       leaf.count * sizeof(V));
+            }
+
+#if !defined(NDEBUG)
+            for (u32 k = (i == 0u ? 1u : 0u); k < leaf.count; k++)
+            {
+                assert(LessT()(sorted_keys.Data[i + k - 1u], leaf.keys[k]));
+            }
+#endif
+
+            if (prev_leaf != InvalidNode)
+            {
+                leaves[prev_leaf].next = leaf_id;
+            }
+            prev_leaf = leaf_id;
+            num_level_nodes++;
+        }
+
+        first_leaf = 0u;
+
+        // Inner levels, level nodes are allocated contiguously so the children
+        // of the level being built are [level_first, level_first + count)
+        u32 level_first = 0u;
+        while (num_level_nodes > 1u)
+        {
+            const u32 next_level_first = inners.Size();
+            u32       next_level_nodes = 0u;
+
+            for (u32 child = 0; child < num_level_nodes;
+                 child += InnerCapacity + 1u)
+            {
+                const u32 num_children =
+                    std::min(InnerCapacity + 1u, num_level_nodes - child);
+
+                const u32  inner_id = new_inner();
+                InnerNode& inner    = inners[inner_id];
+                inner.count         = num_children - 1u;
+
+                for (u32 c = 0; c < num_children; c++)
+                {
+                    const u32 child_id = level_first + child + c;
+                    inner.children[c]  = child_id;
+                    if (c > 0u)
+                    {
+                        inner.keys[c - 1u] = min_key(child_id, height);
+                    }
+                }
+                next_level_nodes++;
+            }
+
+            // a lone trailing child can't form an inner node on its own, its
+            // parent then only has a single child which is still valid
+            level_first     = next_level_first;
+            num_level_nodes = next_level_nodes;
+            height++;
+        }
+
+        root = height == 0u ? 0u : level_first;
+    }
+
+    // ---------------- Ordered iteration ----------------
+
+    struct Entry
+    {
+        const K& key;
+        V&       value;
+    };
+
+    struct Iterator
+    {
+        BTree* tree;
+        u32    leaf;
+        u32    pos;
+
+        Entry operator*() const
+        {
+            LeafNode& node = tree->leaves[leaf];
+            return {node.keys[pos], node.values[pos]};
+        }
+
+        Iterator& operator++()
+        {
+            pos++;
+            skip_exhausted();
+            return *this;
+        }
+
+        bool operator!=(const Iterator& other) const
+        {
+            return leaf != other.leaf || pos != other.pos;
+        }
+
+        // moves past the end of (possibly empty) leaves
+        void skip_exhausted()
+        {
+            while (leaf != InvalidNode && pos >= tree->leaves[leaf].count)
+            {
+                leaf = tree->leaves[leaf].next;
+                pos  = 0u;
+            }
+        }
+    };
+
+    Iterator begin()
+    {
+        Iterator it = {this, first_leaf, 0u};
+        it.skip_exhausted();
+        return it;
+    }
+
+    Iterator end() { return {this, InvalidNode, 0u}; }
+
+    // Iterator to the first entry not less than key
+    Iterator LowerBound(const K& key)
+    {
+        const u32 leaf_id = find_leaf(key);
+
+        Iterator it = {this, leaf_id, leaf_lower_bound(leaves[leaf_id], key)};
+        it.skip_exhausted();
+        return it;
+    }
+
+    /*
+     * Calls func(const K&, V&) for every entry with lo <= key < hi in order.
+     */
+    template <typename Func>
+    void ForEachInRange(const K& lo, const K& hi, Func&& func)
+    {
+        LessT less;
+        for (Iterator it = LowerBound(lo); it != end(); ++it)
+        {
+            Entry entry = *it;
+            if (!less(entry.key, hi))
+            {
+                break;
+            }
+            func(entry.key, entry.value);
+        }
+    }
+
+  private:
+    static inline bool is_equal(const K& a, const K& b)
+    {
+        LessT less;
+        return !less(a, b) && !less(b, a);
+    }
+
+    static inline u32 leaf_lower_bound(const LeafNode& leaf, const K& key)
+    {
+        const View<const K> keys = {.Data        = leaf.keys,
+                                    .NumElements = leaf.count};
+        return AE::lower_bound(keys, key, LessT());
+    }
+
+    // separator i is the smallest key of child i + 1
+    static inline u32 inner_child_slot(const InnerNode& inner, const K& key)
+    {
+        const View<const K> keys = {.Data        = inner.keys,
+                                    .NumElements = inner.count};
+        return AE::upper_bound(keys, key, LessT());
+    }
+
+    u32 find_leaf(const K& key) const
+    {
+        u32 node_id = root;
+        for (u32 level = 0; level < height; level++)
+        {
+            const InnerNode& inner = inners[node_id];
+            node_id = inner.children[inner_child_slot(inner, key)];
+        }
+        return node_id;
+    }
+
+    // smallest key below node_id, which sits level levels above the leaves
+    K min_key(u32 node_id, u32 level) const
+    {
+        for (; level > 0u; level--)
+        {
+            node_id = inners[node_id].children[0];
+        }
+        return leaves[node_id].keys[0];
+    }
+
+    u32 new_leaf()
+    {
+        leaves.Add(LeafNode{});
+        return leaves.Size() - 1u;
+    }
+
+    u32 new_inner()
+    {
+        inners.Add(InnerNode{});
+        return inners.Size() - 1u;
+    }
+
+    template <typename T>
+    static void insert_at(T* data, u32 count, u32 index, const T& elem)
+    {
+        memmove(&data[index + 1u], &data[index], (count - index) * sizeof(T));
+        data[index] = elem;
+    }
+
+    template <typename T>
+    static void remove_at(T* data, u32 count, u32 index)
+    {
+        memmove(&data[index], &data[index + 1u],
+                (count - index - 1u) * sizeof(T));
+    }
+
+    /*
+     * Splits a full leaf while inserting key at pos. Returns the new right
+     * leaf, out_separator receives its first key.
+     */
+    u32 split_leaf(u32 leaf_id, u32 pos, const K& key, const V& value,
+                   K& out_separator)
+    {
+        const u32 right_id = new_leaf();
+        LeafNode& left     = leaves[leaf_id];
+        LeafNode& right    = leaves[right_id];
+
+        constexpr u32 LeftCount  = (LeafCapacity + 1u) / 2u;
+        constexpr u32 RightCount = LeafCapacity + 1u - LeftCount;
+
+        K tmp_keys[LeafCapacity + 1u];
+        V tmp_values[LeafCapacity + 1u];
+        memcpy(tmp_keys, left.keys, LeafCapacity * sizeof(K));
+        memcpy(tmp_values, left.values, LeafCapacity * sizeof(V));
+        insert_at(tmp_keys, LeafCapacity, pos, key);
+        insert_at(tmp_values, LeafCapacity, pos, value);
+
+        memcpy(left.keys, tmp_keys, LeftCount * sizeof(K));
+        memcpy(left.values, tmp_values, LeftCount * sizeof(V));
+        memcpy(right.keys, &tmp_keys[LeftCount], RightCount * sizeof(K));
+        memcpy(right.values, &tmp_values[LeftCount], RightCount * sizeof(V));
+
+        left.count  = LeftCount;
+        right.count = RightCount;
+        right.next  = left.next;
+        left.next   = right_id;
+
+        out_separator = right.keys[0];
+        return right_id;
+    }
+
+    /*
+     * Splits a full inner node while inserting (key, child) after slot. The
+     * middle key moves up into out_separator, returns the new right node.
+     */
+    u32 split_inner(u32 inner_id, u32 slot, const K key, u32 child,
+                    K& out_separator)
+    {
+        const u32  right_id = new_inner();
+        InnerNode& left     = inners[inner_id];
+        InnerNode& right    = inners[right_id];
+
+        constexpr u32 TotalKeys  = InnerCapacity + 1u;
+        constexpr u32 LeftCount  = TotalKeys / 2u;
+        constexpr u32 RightCount = TotalKeys - LeftCount - 1u;
+
+        K   tmp_keys[TotalKeys];
+        u32 tmp_children[TotalKeys + 1u];
+        memcpy(tmp_keys, left.keys, InnerCapacity * sizeof(K));
+        memcpy(tmp_children, left.children, (InnerCapacity + 1u) * sizeof(u32));
+        insert_at(tmp_keys, InnerCapacity, slot, key);
+        insert_at(tmp_children, InnerCapacity + 1u, slot + 1u, child);
+
+        memcpy(left.keys, tmp_keys, LeftCount * sizeof(K));
+        memcpy(left.children, tmp_children, (LeftCount + 1u) * sizeof(u32));
+        memcpy(right.keys, &tmp_keys[LeftCount + 1u], RightCount * sizeof(K));
+        memcpy(right.children, &tmp_children[LeftCount + 1u],
+               (RightCount + 1u) * sizeof(u32));
+
+        left.count  = LeftCount;
+        right.count = RightCount;
+
+        out_separator = tmp_keys[LeftCount];
+        return right_id;
+    }
+};
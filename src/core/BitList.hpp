@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Allocators.hpp"
+#include "BitOps.hpp"
 #include "Containers.hpp"
 #include "Intrinsics.hpp"
 #include "core.hpp"
@@ -120,37 +121,72 @@ struct BitList final
 
     inline bool operator==(const BitList<N, WordType>& other) const
     {
-        return memcmp(&data, &other.data, N * sizeof(WordType));
+        return memcmp(&data, &other.data, sizeof(data)) == 0;
     }
 };
 
+/*
+ * DynamicBitlist
+ *
+ * Growable list of BitList chunks with two summary levels on top, so a
+ * find_first doesn't have to walk every chunk:
+ *
+ *  summary.chunks  1 bit per chunk          (64 chunks per word)
+ *  summary.groups  1 bit per summary word   (4096 chunks per word)
+ *
+ * One summary tracks "has a set bit", the other "has a cleared bit". The group
+ * words are scanned linearly, with 64 bit chunks that's one word per 262144
+ * bits. set_bit/unset_bit keep both summaries up to date in O(1).
+ */
 template <u32 ChunkSize = 32u>
     requires is_power_of_two_v<ChunkSize>
 struct DynamicBitlist
 {
-    static constexpr u32 BitsPerChunk = BitList<ChunkSize>::NumBits;
+    using Chunk = BitList<ChunkSize>;
+
+    static constexpr u32 BitsPerChunk   = Chunk::NumBits;
+    static constexpr u32 BitsPerSummary = 64u;
+
+    struct Summary
+    {
+        Array<u64> chunks;
+        Array<u64> groups;
+    };
 
     constexpr DynamicBitlist(IAllocator& allocator, u32 num_chunks = 2)
         : chunks(allocator, num_chunks),
-          total_capacity(num_chunks * BitsPerChunk)
+          total_capacity(num_chunks * BitsPerChunk),
+          any_set{Array<u64>(allocator), Array<u64>(allocator)},
+          any_free{Array<u64>(allocator), Array<u64>(allocator)}
     {
         chunks.NumElements = chunks._NumAllocated;
+        total_capacity     = chunks.NumElements * BitsPerChunk;
+        rebuild_summaries();
     }
 
-    Array<BitList<ChunkSize>> chunks;
+    Array<Chunk> chunks;
 
     u32 total_capacity;
 
+    Summary any_set;
+    Summary any_free;
+
     void set_bit(u32 index)
     {
         assert(index < total_capacity);
 
         const u32 chunk_idx    = index_to_chunk_index(index);
-        const u32 in_chunk_idx = index - chunk_idx;
+        const u32 in_chunk_idx = index - chunk_idx * BitsPerChunk;
 
         assert(chunk_idx < num_chunks());
 
         chunks[chunk_idx].set_bit(in_chunk_idx);
+
+        summary_mark(any_set, chunk_idx);
+        if (chunk_all(chunk_idx, true))
+        {
+            summary_clear(any_free, chunk_idx);
+        }
     }
 
     void unset_bit(u32 index)
@@ -158,13 +194,30 @@ struct DynamicBitlist
         assert(index < total_capacity);
 
         const u32 chunk_idx    = index_to_chunk_index(index);
-        const u32 in_chunk_idx = index - chunk_idx;
+        const u32 in_chunk_idx = index - chunk_idx * BitsPerChunk;
 
         assert(chunk_idx < num_chunks());
 
         chunks[chunk_idx].unset_bit(in_chunk_idx);
+
+        summary_mark(any_free, chunk_idx);
+        if (chunk_all(chunk_idx, false))
+        {
+            summary_clear(any_set, chunk_idx);
+        }
     }
 
+    inline bool operator[](u32 index) const
+    {
+        assert(index < total_capacity);
+
+        const u32 chunk_idx = index_to_chunk_index(index);
+        return chunks[chunk_idx][index - chunk_idx * BitsPerChunk];
+    }
+
+    /*
+     * Grows to at least new_capacity bits (doubling), new bits are cleared.
+     */
     void resize(u32 new_capacity)
     {
         if (new_capacity <= total_capacity)
@@ -172,94 +225,692 @@ struct DynamicBitlist
             return;
         }
 
-        const u32 new_num_chunks = round_up_pow2(new_capacity / BitsPerChunk);
-        chunks.Resize(new_num_chunks);
+        const u32 old_num_chunks = num_chunks();
+        const u32 new_num_chunks =
+            round_up_pow2((new_capacity + BitsPerChunk - 1u) / BitsPerChunk);
+
+        chunks.add_no_init(new_num_chunks - old_num_chunks);
+        for (u32 i = old_num_chunks; i < new_num_chunks; i++)
+        {
+            chunks[i] = Chunk();
+        }
 
         total_capacity = BitsPerChunk * new_num_chunks;
+
+        // growing doubles the size, rebuilding is amortized O(1) per bit
+        rebuild_summaries();
+    }
+
+    /*
+     * Recomputes both summaries from the chunks, e.g. after the chunks were
+     * written directly (loading an archive).
+     */
+    void rebuild_summaries()
+    {
+        if (num_chunks() == 0u)
+        {
+            return;
+        }
+
+        const u32 num_words  = summary_words(num_chunks());
+        const u32 num_groups = summary_words(num_words);
+
+        for (Summary* summary : {&any_set, &any_free})
+        {
+            summary->chunks.NumElements = 0u;
+            summary->groups.NumElements = 0u;
+            summary->chunks.add_no_init(num_words);
+            summary->groups.add_no_init(num_groups);
+
+            for (u32 i = 0; i < num_words; i++)
+            {
+                summary->chunks[i] = 0u;
+            }
+            for (u32 i = 0; i < num_groups; i++)
+            {
+                summary->groups[i] = 0u;
+            }
+        }
+
+        for (u32 i = 0; i < num_chunks(); i++)
+        {
+            if (!chunk_all(i, false))
+            {
+                summary_mark(any_set, i);
+            }
+            if (!chunk_all(i, true))
+            {
+                summary_mark(any_free, i);
+            }
+        }
     }
 
     inline const u32 index_to_chunk_index(u32 index) const
     {
-        return round_down(index, BitsPerChunk) / BitsPerChunk;
+        return index / BitsPerChunk;
     }
 
     /*
-     * Find first flag starting from the given index. start_index excluded.
+     * Find first flag starting from the given index (included), -1 if there
+     * is none.
      */
     i32 find_first(bool flag, u32 start_index = 0u) const
     {
-        for (u32 i = 0; i < chunks.NumElements; i++)
+        if (start_index >= total_capacity)
+        {
+            return -1;
+        }
+
+        const Summary& summary = flag ? any_set : any_free;
+
+        // rest of the start chunk
+        u32       chunk_idx = index_to_chunk_index(start_index);
+        const i32 in_chunk =
+            find_in_chunk(flag, chunk_idx, start_index - chunk_idx * BitsPerChunk);
+        if (in_chunk >= 0)
         {
-            i32 first_in_chunk = chunks[i].find_first(flag);
-            if (first_in_chunk >= 0)
+            return chunk_idx * BitsPerChunk + in_chunk;
+        }
+
+        // rest of the summary word of the start chunk
+        const u32 next_chunk = chunk_idx + 1u;
+        u32       word_idx   = next_chunk / BitsPerSummary;
+        if (next_chunk < num_chunks())
+        {
+            const u64 word = summary.chunks[word_idx] &
+                             (~0ull << (next_chunk % BitsPerSummary));
+            if (word != 0u)
+            {
+                return first_in_word(flag, word_idx, word);
+            }
+        }
+
+        // rest of the group of that summary word
+        const u32 next_word = word_idx + 1u;
+        u32       group_idx = next_word / BitsPerSummary;
+        if (next_word < summary.chunks.NumElements)
+        {
+            const u64 group = summary.groups[group_idx] &
+                              (~0ull << (next_word % BitsPerSummary));
+            if (group != 0u)
+            {
+                return first_in_group(flag, summary, group_idx, group);
+            }
+        }
+
+        // following groups
+        for (group_idx++; group_idx < summary.groups.NumElements; group_idx++)
+        {
+            if (summary.groups[group_idx] != 0u)
             {
-                return first_in_chunk + i;
+                return first_in_group(flag, summary, group_idx,
+                                      summary.groups[group_idx]);
             }
         }
+
+        return -1;
     }
 
-    inline const u32 size_bits() const { num_chunks() * ChunkSize; }
+    inline u32 size_bits() const { return total_capacity; }
 
     inline const u32 num_chunks() const { return chunks.NumElements; }
+
+  private:
+    static inline u32 summary_words(u32 num_bits)
+    {
+        return (num_bits + BitsPerSummary - 1u) / BitsPerSummary;
+    }
+
+    static inline void summary_mark(Summary& summary, u32 chunk_idx)
+    {
+        const u32 word_idx = chunk_idx / BitsPerSummary;
+
+        summary.chunks[word_idx] |= 1ull << (chunk_idx % BitsPerSummary);
+        summary.groups[word_idx / BitsPerSummary] |= 1ull
+                                                    << (word_idx % BitsPerSummary);
+    }
+
+    static inline void summary_clear(Summary& summary, u32 chunk_idx)
+    {
+        const u32 word_idx = chunk_idx / BitsPerSummary;
+
+        summary.chunks[word_idx] &= ~(1ull << (chunk_idx % BitsPerSummary));
+        if (summary.chunks[word_idx] == 0u)
+        {
+            summary.groups[word_idx / BitsPerSummary] &=
+                ~(1ull << (word_idx % BitsPerSummary));
+        }
+    }
+
+    // true when every bit of the chunk equals flag
+    inline bool chunk_all(u32 chunk_idx, bool flag) const
+    {
+        const Chunk& chunk = chunks[chunk_idx];
+        for (u32 w = 0; w < Chunk::NumWords; w++)
+        {
+            if (chunk.data[w] != (flag ? (u32)~0u : 0u))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    inline i32 find_in_chunk(bool flag, u32 chunk_idx, u32 start_bit) const
+    {
+        const Chunk& chunk = chunks[chunk_idx];
+        for (u32 w = start_bit / Chunk::BitsPerWord; w < Chunk::NumWords; w++)
+        {
+            u32 word = flag ? chunk.data[w] : ~chunk.data[w];
+            if (w == start_bit / Chunk::BitsPerWord)
+            {
+                word &= ~0u << (start_bit % Chunk::BitsPerWord);
+            }
+
+            if (word != 0u)
+            {
+                return (i32)(w * Chunk::BitsPerWord) + Intrinsics::find_lsb(word);
+            }
+        }
+        return -1;
+    }
+
+    inline i32 first_in_word(bool flag, u32 word_idx, u64 word) const
+    {
+        const u32 chunk_idx =
+            word_idx * BitsPerSummary + (u32)Intrinsics::find_lsb(word);
+        return chunk_idx * BitsPerChunk + find_in_chunk(flag, chunk_idx, 0u);
+    }
+
+    inline i32 first_in_group(bool flag, const Summary& summary, u32 group_idx,
+                              u64 group) const
+    {
+        const u32 word_idx =
+            group_idx * BitsPerSummary + (u32)Intrinsics::find_lsb(group);
+        return first_in_word(flag, word_idx, summary.chunks[word_idx]);
+    }
 };
 
 static constexpr u32 aantal_bits = BitList<128>::NumBits;
 
+// ---------------- Bulk operations ----------------
+//
+// Whole list operations through the BitOps kernels (SSE2/AVX2/AVX-512,
+// picked at runtime). The DynamicBitlist versions need lists with the same
+// number of chunks and rebuild the destination's summaries.
+
+template <u32 N, typename WordType>
+inline constexpr u32 bitlist_num_blocks()
+{
+    static_assert(sizeof(BitList<N, WordType>) % 16u == 0u);
+    return sizeof(BitList<N, WordType>) / 16u;
+}
+
+template <u32 N, typename WordType>
+inline BitOps::BlockMask bitlist_mask()
+{
+    constexpr u32 num_blocks = bitlist_num_blocks<N, WordType>();
+
+    BitOps::BlockMask mask;
+    BitOps::block_mask(N - (num_blocks - 1u) * 128u, mask.last);
+    return mask;
+}
+
+template <u32 ChunkSize>
+inline BitOps::BlockMask bitlist_mask(const DynamicBitlist<ChunkSize>&)
+{
+    using Chunk = typename DynamicBitlist<ChunkSize>::Chunk;
+
+    // 16 byte chunks repeat their pattern, bigger ones are whole blocks
+    BitOps::BlockMask mask;
+    if constexpr (sizeof(Chunk) == 16u)
+    {
+        BitOps::block_mask(Chunk::NumBits, mask.pattern);
+    }
+    return mask;
+}
+
+template <u32 ChunkSize>
+inline u32 bitlist_num_blocks(const DynamicBitlist<ChunkSize>& list)
+{
+    using Chunk = typename DynamicBitlist<ChunkSize>::Chunk;
+    static_assert(sizeof(Chunk) % 16u == 0u);
+
+    return list.num_chunks() * (sizeof(Chunk) / 16u);
+}
+
+template <u32 N, typename WordType>
+inline void bitlist_binary(BitOps::EBinaryOp op, BitList<N, WordType>& dst,
+                           const BitList<N, WordType>& a,
+                           const BitList<N, WordType>& b)
+{
+    BitOps::kernels().binary[(u32)op]((u8*)dst.data, (const u8*)a.data,
+                                      (const u8*)b.data,
+                                      bitlist_num_blocks<N, WordType>());
+}
+
+template <u32 ChunkSize>
+inline void bitlist_binary(BitOps::EBinaryOp op, DynamicBitlist<ChunkSize>& dst,
+                           const DynamicBitlist<ChunkSize>& a,
+                           const DynamicBitlist<ChunkSize>& b)
+{
+    assert(a.num_chunks() == b.num_chunks());
+    dst.resize(a.total_capacity);
+    assert(dst.num_chunks() == a.num_chunks());
+
+    BitOps::kernels().binary[(u32)op]((u8*)dst.chunks.Data,
+                                      (const u8*)a.chunks.Data,
+                                      (const u8*)b.chunks.Data,
+                                      bitlist_num_blocks(a));
+    dst.rebuild_summaries();
+}
+
+template <typename ListT>
+inline void bitlist_and(ListT& dst, const ListT& a, const ListT& b)
+{
+    bitlist_binary(BitOps::EBinaryOp::AND, dst, a, b);
+}
+
+template <typename ListT>
+inline void bitlist_or(ListT& dst, const ListT& a, const ListT& b)
+{
+    bitlist_binary(BitOps::EBinaryOp::OR, dst, a, b);
+}
+
+template <typename ListT>
+inline void bitlist_xor(ListT& dst, const ListT& a, const ListT& b)
+{
+    bitlist_binary(BitOps::EBinaryOp::XOR, dst, a, b);
+}
+
+// dst = a & ~b
+template <typename ListT>
+inline void bitlist_andnot(ListT& dst, const ListT& a, const ListT& b)
+{
+    bitlist_binary(BitOps::EBinaryOp::ANDNOT, dst, a, b);
+}
+
+template <u32 N, typename WordType>
+inline void bitlist_not(BitList<N, WordType>& dst, const BitList<N, WordType>& a)
+{
+    BitOps::kernels().bit_not((u8*)dst.data, (const u8*)a.data,
+                              bitlist_num_blocks<N, WordType>(),
+                              bitlist_mask<N, WordType>());
+}
+
+template <u32 ChunkSize>
+inline void bitlist_not(DynamicBitlist<ChunkSize>&       dst,
+                        const DynamicBitlist<ChunkSize>& a)
+{
+    dst.resize(a.total_capacity);
+    assert(dst.num_chunks() == a.num_chunks());
+
+    BitOps::kernels().bit_not((u8*)dst.chunks.Data, (const u8*)a.chunks.Data,
+                              bitlist_num_blocks(a), bitlist_mask(a));
+    dst.rebuild_summaries();
+}
+
+template <u32 N, typename WordType>
+inline u32 bitlist_popcount(const BitList<N, WordType>& a)
+{
+    return (u32)BitOps::kernels().popcount((const u8*)a.data, nullptr,
+                                           bitlist_num_blocks<N, WordType>(),
+                                           bitlist_mask<N, WordType>());
+}
+
+template <u32 ChunkSize>
+inline u32 bitlist_popcount(const DynamicBitlist<ChunkSize>& a)
+{
+    return (u32)BitOps::kernels().popcount((const u8*)a.chunks.Data, nullptr,
+                                           bitlist_num_blocks(a),
+                                           bitlist_mask(a));
+}
+
+// Number of bits that differ, popcount(a ^ b)
+template <u32 N, typename WordType>
+inline u32 bitlist_count_diff(const BitList<N, WordType>& a,
+                              const BitList<N, WordType>& b)
+{
+    return (u32)BitOps::kernels().popcount_xor(
+        (const u8*)a.data, (const u8*)b.data, bitlist_num_blocks<N, WordType>(),
+        bitlist_mask<N, WordType>());
+}
+
+template <u32 ChunkSize>
+inline u32 bitlist_count_diff(const DynamicBitlist<ChunkSize>& a,
+                              const DynamicBitlist<ChunkSize>& b)
+{
+    assert(a.num_chunks() == b.num_chunks());
+    return (u32)BitOps::kernels().popcount_xor(
+        (const u8*)a.chunks.Data, (const u8*)b.chunks.Data,
+        bitlist_num_blocks(a), bitlist_mask(a));
+}
+
+template <u32 N, typename WordType>
+inline bool bitlist_none(const BitList<N, WordType>& a)
+{
+    return BitOps::kernels().is_zero((const u8*)a.data, nullptr,
+                                     bitlist_num_blocks<N, WordType>(),
+                                     bitlist_mask<N, WordType>());
+}
+
+template <u32 ChunkSize>
+inline bool bitlist_none(const DynamicBitlist<ChunkSize>& a)
+{
+    return BitOps::kernels().is_zero((const u8*)a.chunks.Data, nullptr,
+                                     bitlist_num_blocks(a), bitlist_mask(a));
+}
+
+template <typename ListT>
+inline bool bitlist_any(const ListT& a)
+{
+    return !bitlist_none(a);
+}
+
+template <u32 N, typename WordType>
+inline bool bitlist_all(const BitList<N, WordType>& a)
+{
+    return bitlist_popcount(a) == N;
+}
+
+template <u32 ChunkSize>
+inline bool bitlist_all(const DynamicBitlist<ChunkSize>& a)
+{
+    return bitlist_popcount(a) == a.total_capacity;
+}
+
+template <u32 N, typename WordType>
+inline bool bitlist_equal(const BitList<N, WordType>& a,
+                          const BitList<N, WordType>& b)
+{
+    return BitOps::kernels().is_zero_xor((const u8*)a.data, (const u8*)b.data,
+                                         bitlist_num_blocks<N, WordType>(),
+                                         bitlist_mask<N, WordType>());
+}
+
+template <u32 ChunkSize>
+inline bool bitlist_equal(const DynamicBitlist<ChunkSize>& a,
+                          const DynamicBitlist<ChunkSize>& b)
+{
+    return a.num_chunks() == b.num_chunks() &&
+           BitOps::kernels().is_zero_xor(
+               (const u8*)a.chunks.Data, (const u8*)b.chunks.Data,
+               bitlist_num_blocks(a), bitlist_mask(a));
+}
+
 template <u32 N>
 BitList<N> bitlist_changed(const BitList<N>& a, const BitList<N>& b)
 {
-    assert(BitList<N>::BitsPerWord <= 128u);
-
     BitList<N> result;
+    bitlist_xor(result, a, b);
+    return result;
+}
+
+// ---------------- Set bit iteration, rank and select ----------------
+
+template <u32 N, typename WordType>
+inline BitOps::BitSpan bitlist_span(const BitList<N, WordType>& list)
+{
+    return {.data       = (const u8*)list.data,
+            .num_blocks = bitlist_num_blocks<N, WordType>(),
+            .mask       = bitlist_mask<N, WordType>()};
+}
+
+template <u32 ChunkSize>
+inline BitOps::BitSpan bitlist_span(const DynamicBitlist<ChunkSize>& list)
+{
+    return {.data       = (const u8*)list.chunks.Data,
+            .num_blocks = bitlist_num_blocks(list),
+            .mask       = bitlist_mask(list)};
+}
+
+/*
+ * Walks the set bits a u64 word at a time: tzcnt for the index, blsr to clear
+ * it, whole zero words are skipped.
+ *
+ *  for (u32 index : set_bits(visible)) { ... }
+ */
+class SetBitIterator
+{
+  public:
+    struct End
+    {
+    };
+
+    explicit SetBitIterator(const BitOps::BitSpan& span) : span(span)
+    {
+        if (span.num_words() > 0u)
+        {
+            bits = span.word(0u);
+            skip_empty_words();
+        }
+    }
+
+    inline u32 operator*() const { return base + (u32)__builtin_ctzll(bits); }
+
+    inline SetBitIterator& operator++()
+    {
+        bits &= bits - 1u;
+        skip_empty_words();
+        return *this;
+    }
+
+    inline bool operator==(End) const { return word_index >= span.num_words(); }
+
+  private:
+    inline void skip_empty_words()
+    {
+        while (bits == 0u && ++word_index < span.num_words())
+        {
+            base += span.mask.word_width(word_index - 1u);
+            bits = span.word(word_index);
+        }
+    }
+
+    BitOps::BitSpan span;
+    u32             word_index = 0u;
+    u32             base       = 0u;
+    u64             bits       = 0u;
+};
+
+struct SetBits
+{
+    BitOps::BitSpan span;
 
-    constexpr u32 words_per_chunk = 128u / BitList<N>::BitsPerWord;
+    inline SetBitIterator      begin() const { return SetBitIterator(span); }
+    inline SetBitIterator::End end() const { return {}; }
+};
+
+template <typename ListT>
+inline SetBits set_bits(const ListT& list)
+{
+    return {bitlist_span(list)};
+}
+
+template <typename ListT, typename FuncT>
+inline void bitlist_for_each_set(const ListT& list, FuncT&& func)
+{
+    const BitOps::BitSpan span = bitlist_span(list);
 
-    for (u32 i = 0; i < BitList<N>::NumWords; i += words_per_chunk)
+    u32 base = 0u;
+    for (u32 w = 0; w < span.num_words(); w++)
     {
-        __m128i chunk_a;
-        __m128i chunk_b;
+        for (u64 bits = span.word(w); bits != 0u; bits &= bits - 1u)
+        {
+            func(base + (u32)__builtin_ctzll(bits));
+        }
+        base += span.mask.word_width(w);
+    }
+}
 
-        u128 pad_chunk_a;
-        u128 pad_chunk_b;
+/*
+ * Appends the indices of all set bits to out, returns how many were added.
+ * Uses VPCOMPRESSD when AVX-512 is available.
+ */
+template <typename ListT>
+inline u32 bitlist_extract_set(const ListT& list, Array<u32>& out)
+{
+    const BitOps::BitSpan span      = bitlist_span(list);
+    const u32             num_found = (u32)BitOps::kernels().popcount(
+        span.data, nullptr, span.num_blocks, span.mask);
+
+    // the SIMD kernel stores whole registers past the last index
+    const u32 first = out.NumElements;
+    out.Reserve(first + num_found + 16u);
+
+    const u32 num_extracted =
+        BitOps::kernels().extract(span, &out.Data[first]);
+    assert(num_extracted == num_found);
 
-        bool pad_chunk = i + words_per_chunk >= BitList<N>::NumWords;
-        if (pad_chunk)
+    out.NumElements = first + num_extracted;
+    return num_extracted;
+}
+
+/*
+ * RankSelect
+ *
+ * Auxiliary index over a BitList/DynamicBitlist: the number of set bits
+ * before every 512 bit superblock (4 bytes per 64 bytes of bits). Needs a
+ * build() after the list changes.
+ *
+ *  rank(i)    number of set bits before index i
+ *  select(k)  index of the k-th set bit (k = 0 is the first), -1 if there
+ *             are k or fewer set bits
+ */
+class RankSelect final
+{
+  public:
+    static constexpr u32 WordsPerSample = 8u;
+
+  public:
+    BitOps::BitSpan span;
+    Array<u32>      samples; // set bits before word s * WordsPerSample
+    u32             num_set = 0u;
+
+  public:
+    explicit RankSelect(IAllocator& allocator) : samples(allocator, 16u) {}
+
+    template <typename ListT>
+    void build(const ListT& list)
+    {
+        span = bitlist_span(list);
+
+        const u32 num_words = span.num_words();
+
+        samples.NumElements = 0u;
+        samples.add_no_init(num_words / WordsPerSample + 1u);
+
+        u32 count = 0u;
+        for (u32 w = 0; w < num_words; w++)
         {
-            const u32 num_remaining_bytes =
-                (BitList<N>::NumWords - i) * (BitList<N>::BitsPerWord / 8u);
+            if (w % WordsPerSample == 0u)
+            {
+                samples[w / WordsPerSample] = count;
+            }
+            count += (u32)__builtin_popcountll(span.word(w));
+        }
+        if (num_words % WordsPerSample == 0u)
+        {
+            samples[num_words / WordsPerSample] = count;
+        }
 
-            // init padded chunks to zero
-            pad_chunk_a = {.value = {.ll = {0u, 0u}}};
-            pad_chunk_b = {.value = {.ll = {0u, 0u}}};
+        num_set = count;
+    }
+
+    u32 rank(u32 index) const
+    {
+        u32 word, bit;
+        logical_to_word(index, word, bit);
+
+        if (word >= span.num_words())
+        {
+            return num_set;
+        }
+
+        u32 result = samples[word / WordsPerSample];
+        for (u32 w = round_down(word, WordsPerSample); w < word; w++)
+        {
+            result += (u32)__builtin_popcountll(span.word(w));
+        }
 
-            memcpy(&pad_chunk_a, &a.data[i], num_remaining_bytes);
-            memcpy(&pad_chunk_b, &b.data[i], num_remaining_bytes);
+        const u64 below = bit == 0u ? 0u : span.word(word) & (~0ull >> (64u - bit));
+        return result + (u32)__builtin_popcountll(below);
+    }
 
-            chunk_a = _mm_load_si128((__m128i*)&pad_chunk_a.value);
-            chunk_b = _mm_load_si128((__m128i*)&pad_chunk_b.value);
+    i32 select(u32 k) const
+    {
+        if (k >= num_set)
+        {
+            return -1;
         }
-        else
+
+        // last sample with at most k set bits before it
+        u32 lo = 0u;
+        u32 hi = samples.NumElements - 1u;
+        while (lo < hi)
         {
-            chunk_a = _mm_load_si128((__m128i*)&a.data[i]);
-            chunk_b = _mm_load_si128((__m128i*)&b.data[i]);
+            const u32 mid = (lo + hi + 1u) / 2u;
+            if (samples[mid] <= k)
+            {
+                lo = mid;
+            }
+            else
+            {
+                hi = mid - 1u;
+            }
         }
 
-        __m128i chunk_result = _mm_xor_si128(chunk_a, chunk_b);
+        k -= samples[lo];
+        for (u32 w = lo * WordsPerSample;; w++)
+        {
+            const u64 bits  = span.word(w);
+            const u32 count = (u32)__builtin_popcountll(bits);
+            if (k < count)
+            {
+                return (i32)(word_base(w) + select_in_word(bits, k));
+            }
+            k -= count;
+        }
+    }
 
-        // copy result from register to resulting array
-        memcpy(&result.data[i], &chunk_result, sizeof(__m128i));
+  private:
+    // logical index of the first bit of word w
+    inline u32 word_base(u32 w) const
+    {
+        const u32 width0 = span.mask.word_width(0u);
+        const u32 width1 = span.mask.word_width(1u);
+        return (w / 2u) * (width0 + width1) + ((w & 1u) ? width0 : 0u);
     }
 
-// VALIDATION
-#if 0
-    BitList<N> result_validation;
-    for (u32 i = 0u; i < BitList<N>::NumWords; i++)
+    inline void logical_to_word(u32 index, u32& out_word, u32& out_bit) const
     {
-        result_validation.data[i] = a.data[i] ^ b.data[i];
+        const u32 width0      = span.mask.word_width(0u);
+        const u32 block_width = width0 + span.mask.word_width(1u);
+        const u32 in_block    = index % block_width;
+
+        out_word = (index / block_width) * 2u + (in_block >= width0 ? 1u : 0u);
+        out_bit  = in_block >= width0 ? in_block - width0 : in_block;
     }
 
-    assert(result == result_validation);
-#endif
+    // position of the k-th set bit of bits, byte counts first then bit by bit
+    static inline u32 select_in_word(u64 bits, u32 k)
+    {
+        u32 shift = 0u;
+        for (;; shift += 8u)
+        {
+            const u32 count = (u32)__builtin_popcountll((bits >> shift) & 0xffu);
+            if (k < count)
+            {
+                break;
+            }
+            k -= count;
+        }
 
-    return result;
-}
+        u64 byte_bits = (bits >> shift) & 0xffu;
+        for (; k > 0u; k--)
+        {
+            byte_bits &= byte_bits - 1u;
+        }
+        return shift + (u32)__builtin_ctzll(byte_bits);
+    }
+};
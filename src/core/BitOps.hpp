@@ -0,0 +1,632 @@
+#pragma once
+
+#include "Intrinsics.hpp"
+#include "core.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <immintrin.h>
+
+/*
+ * Bulk bitset kernels
+ *
+ * Work on 16 byte blocks (BitList storage is 16 byte aligned and sized), with
+ * SSE2, AVX2 and AVX-512 versions picked once at runtime from the cpu
+ * features. The typed wrappers (bitlist_and, bitlist_popcount, ...) live in
+ * BitList.hpp.
+ *
+ * A BlockMask selects the logical bits: `pattern` applies to every block and
+ * `last` additionally to the final one. A single BitList uses a full pattern
+ * and masks the tail of its last block, an array of 64 bit chunks (each
+ * padded to 16 bytes) repeats a half block pattern. Reads (popcount, zero
+ * tests) only look at masked bits and bit_not only flips those, so whatever
+ * is in the padding doesn't matter.
+ */
+namespace BitOps
+{
+
+enum class EBinaryOp : u32
+{
+    AND,
+    OR,
+    XOR,
+    ANDNOT, // a & ~b
+    COUNT
+};
+
+struct BlockMask
+{
+    u64 pattern[2] = {~0ull, ~0ull};
+    u64 last[2]    = {~0ull, ~0ull};
+
+    inline void final_mask(u64 (&out)[2]) const
+    {
+        out[0] = pattern[0] & last[0];
+        out[1] = pattern[1] & last[1];
+    }
+
+    // mask of u64 word w (2 per block) of a num_blocks long stream
+    inline u64 word_mask(u32 w, u32 num_blocks) const
+    {
+        const u64 mask = pattern[w & 1u];
+        return w / 2u + 1u == num_blocks ? mask & last[w & 1u] : mask;
+    }
+
+    // logical bits in u64 word w, masks are prefixes so padding words add 0
+    inline u32 word_width(u32 w) const
+    {
+        return (u32)__builtin_popcountll(pattern[w & 1u]);
+    }
+};
+
+/*
+ * Bits of a list as seen by the kernels: its storage as 16 byte blocks plus
+ * the mask of the logical bits.
+ */
+struct BitSpan
+{
+    const u8* data       = nullptr;
+    u32       num_blocks = 0u;
+    BlockMask mask;
+
+    inline u32 num_words() const { return num_blocks * 2u; }
+
+    inline u64 word(u32 w) const
+    {
+        u64 bits;
+        memcpy(&bits, data + w * sizeof(u64), sizeof(u64));
+        return bits & mask.word_mask(w, num_blocks);
+    }
+};
+
+using BinaryKernel = void (*)(u8* dst, const u8* a, const u8* b, u32 num_blocks);
+
+// dst = a ^ mask
+using NotKernel = void (*)(u8* dst, const u8* a, u32 num_blocks,
+                           const BlockMask& mask);
+
+// b is ignored by the plain versions, the Xor versions work on a ^ b
+using PopcountKernel = u64 (*)(const u8* a, const u8* b, u32 num_blocks,
+                               const BlockMask& mask);
+using IsZeroKernel   = bool (*)(const u8* a, const u8* b, u32 num_blocks,
+                              const BlockMask& mask);
+
+// Writes the logical indices of the set bits to out, returns how many. out
+// needs room for 16 indices more than that, the SIMD version stores whole
+// registers.
+using ExtractKernel = u32 (*)(const BitSpan& span, u32* out);
+
+struct Kernels
+{
+    BinaryKernel   binary[(u32)EBinaryOp::COUNT];
+    NotKernel      bit_not;
+    PopcountKernel popcount;
+    PopcountKernel popcount_xor;
+    IsZeroKernel   is_zero;
+    IsZeroKernel   is_zero_xor;
+    ExtractKernel  extract;
+};
+
+namespace Detail
+{
+
+// ---------------- SSE2 ----------------
+//
+// Besides being the baseline, the SSE2 kernels finish the blocks the wider
+// kernels leave over, final (masked) block included.
+
+inline __m128i load_mask_sse2(const u64 (&mask)[2])
+{
+    return _mm_loadu_si128((const __m128i*)mask);
+}
+
+template <EBinaryOp Op>
+inline __m128i apply_sse2(__m128i a, __m128i b)
+{
+    if constexpr (Op == EBinaryOp::AND)
+    {
+        return _mm_and_si128(a, b);
+    }
+    else if constexpr (Op == EBinaryOp::OR)
+    {
+        return _mm_or_si128(a, b);
+    }
+    else if constexpr (Op == EBinaryOp::XOR)
+    {
+        return _mm_xor_si128(a, b);
+    }
+    else
+    {
+        return _mm_andnot_si128(b, a);
+    }
+}
+
+template <EBinaryOp Op>
+inline void binary_sse2(u8* dst, const u8* a, const u8* b, u32 num_blocks)
+{
+    for (u32 i = 0; i < num_blocks; i++)
+    {
+        const __m128i va = _mm_loadu_si128((const __m128i*)a + i);
+        const __m128i vb = _mm_loadu_si128((const __m128i*)b + i);
+        _mm_storeu_si128((__m128i*)dst + i, apply_sse2<Op>(va, vb));
+    }
+}
+
+inline void not_sse2(u8* dst, const u8* a, u32 num_blocks, const BlockMask& mask)
+{
+    if (num_blocks == 0u)
+    {
+        return;
+    }
+
+    const __m128i pattern = load_mask_sse2(mask.pattern);
+    for (u32 i = 0; i + 1u < num_blocks; i++)
+    {
+        const __m128i va = _mm_loadu_si128((const __m128i*)a + i);
+        _mm_storeu_si128((__m128i*)dst + i, _mm_xor_si128(va, pattern));
+    }
+
+    u64 final[2];
+    mask.final_mask(final);
+
+    const u32     i  = num_blocks - 1u;
+    const __m128i va = _mm_loadu_si128((const __m128i*)a + i);
+    _mm_storeu_si128((__m128i*)dst + i, _mm_xor_si128(va, load_mask_sse2(final)));
+}
+
+template <bool Xor>
+inline __m128i load_block_sse2(const u8* a, const u8* b, u32 block)
+{
+    __m128i v = _mm_loadu_si128((const __m128i*)a + block);
+    if constexpr (Xor)
+    {
+        v = _mm_xor_si128(v, _mm_loadu_si128((const __m128i*)b + block));
+    }
+    return v;
+}
+
+template <bool Xor>
+inline u64 load_word(const u8* a, const u8* b, u32 word)
+{
+    u64 wa;
+    memcpy(&wa, a + word * sizeof(u64), sizeof(u64));
+    if constexpr (Xor)
+    {
+        u64 wb;
+        memcpy(&wb, b + word * sizeof(u64), sizeof(u64));
+        wa ^= wb;
+    }
+    return wa;
+}
+
+template <bool Xor>
+inline u64 popcount_scalar(const u8* a, const u8* b, u32 num_blocks,
+                           const BlockMask& mask)
+{
+    if (num_blocks == 0u)
+    {
+        return 0u;
+    }
+
+    u64 count = 0u;
+    for (u32 w = 0; w < (num_blocks - 1u) * 2u; w++)
+    {
+        count += (u64)__builtin_popcountll(load_word<Xor>(a, b, w) &
+                                           mask.pattern[w & 1u]);
+    }
+
+    u64 final[2];
+    mask.final_mask(final);
+
+    const u32 w = (num_blocks - 1u) * 2u;
+    count += (u64)__builtin_popcountll(load_word<Xor>(a, b, w) & final[0]);
+    count += (u64)__builtin_popcountll(load_word<Xor>(a, b, w + 1u) & final[1]);
+    return count;
+}
+
+// Same as the scalar version, compiled for the popcnt instruction
+template <bool Xor>
+TARGET_POPCNT inline u64 popcount_popcnt(const u8* a, const u8* b,
+                                         u32 num_blocks, const BlockMask& mask)
+{
+    return popcount_scalar<Xor>(a, b, num_blocks, mask);
+}
+
+template <bool Xor>
+inline bool is_zero_sse2(const u8* a, const u8* b, u32 num_blocks,
+                         const BlockMask& mask)
+{
+    if (num_blocks == 0u)
+    {
+        return true;
+    }
+
+    const __m128i pattern = load_mask_sse2(mask.pattern);
+
+    __m128i acc = _mm_setzero_si128();
+    for (u32 i = 0; i + 1u < num_blocks; i++)
+    {
+        acc = _mm_or_si128(acc, _mm_and_si128(load_block_sse2<Xor>(a, b, i),
+                                              pattern));
+    }
+
+    u64 final[2];
+    mask.final_mask(final);
+    acc = _mm_or_si128(acc, _mm_and_si128(load_block_sse2<Xor>(a, b, num_blocks - 1u),
+                                          load_mask_sse2(final)));
+
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(acc, _mm_setzero_si128())) ==
+           0xffff;
+}
+
+inline u32 extract_scalar(const BitSpan& span, u32* out)
+{
+    u32 num_extracted = 0u;
+    u32 base          = 0u;
+    for (u32 w = 0; w < span.num_words(); w++)
+    {
+        // tzcnt + blsr per set bit
+        for (u64 bits = span.word(w); bits != 0u; bits &= bits - 1u)
+        {
+            out[num_extracted++] = base + (u32)__builtin_ctzll(bits);
+        }
+        base += span.mask.word_width(w);
+    }
+    return num_extracted;
+}
+
+// ---------------- AVX2 ----------------
+
+template <EBinaryOp Op>
+TARGET_AVX2 inline __m256i apply_avx2(__m256i a, __m256i b)
+{
+    if constexpr (Op == EBinaryOp::AND)
+    {
+        return _mm256_and_si256(a, b);
+    }
+    else if constexpr (Op == EBinaryOp::OR)
+    {
+        return _mm256_or_si256(a, b);
+    }
+    else if constexpr (Op == EBinaryOp::XOR)
+    {
+        return _mm256_xor_si256(a, b);
+    }
+    else
+    {
+        return _mm256_andnot_si256(b, a);
+    }
+}
+
+TARGET_AVX2 inline __m256i load_pattern_avx2(const BlockMask& mask)
+{
+    return _mm256_broadcastsi128_si256(load_mask_sse2(mask.pattern));
+}
+
+template <bool Xor>
+TARGET_AVX2 inline __m256i load_blocks_avx2(const u8* a, const u8* b, u32 block)
+{
+    __m256i v = _mm256_loadu_si256((const __m256i*)(a + block * 16u));
+    if constexpr (Xor)
+    {
+        v = _mm256_xor_si256(v, _mm256_loadu_si256((const __m256i*)(b + block * 16u)));
+    }
+    return v;
+}
+
+template <EBinaryOp Op>
+TARGET_AVX2 inline void binary_avx2(u8* dst, const u8* a, const u8* b,
+                                    u32 num_blocks)
+{
+    u32 i = 0;
+    for (; i + 2u <= num_blocks; i += 2u)
+    {
+        const __m256i va = _mm256_loadu_si256((const __m256i*)(a + i * 16u));
+        const __m256i vb = _mm256_loadu_si256((const __m256i*)(b + i * 16u));
+        _mm256_storeu_si256((__m256i*)(dst + i * 16u), apply_avx2<Op>(va, vb));
+    }
+    binary_sse2<Op>(dst + i * 16u, a + i * 16u, b + i * 16u, num_blocks - i);
+}
+
+TARGET_AVX2 inline void not_avx2(u8* dst, const u8* a, u32 num_blocks,
+                                 const BlockMask& mask)
+{
+    const __m256i pattern = load_pattern_avx2(mask);
+
+    // stops before the final block, which needs the `last` mask
+    u32 i = 0;
+    for (; i + 2u < num_blocks; i += 2u)
+    {
+        const __m256i va = _mm256_loadu_si256((const __m256i*)(a + i * 16u));
+        _mm256_storeu_si256((__m256i*)(dst + i * 16u),
+                            _mm256_xor_si256(va, pattern));
+    }
+    not_sse2(dst + i * 16u, a + i * 16u, num_blocks - i, mask);
+}
+
+// Nibble lookup popcount (Mula), the per byte counts are summed per u64 lane
+// with sad
+TARGET_AVX2 inline __m256i popcount_bytes_avx2(__m256i v)
+{
+    const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2,
+                                         3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2,
+                                         2, 3, 2, 3, 3, 4);
+    const __m256i low_nibble = _mm256_set1_epi8(0x0f);
+
+    const __m256i lo = _mm256_and_si256(v, low_nibble);
+    const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_nibble);
+    return _mm256_add_epi8(_mm256_shuffle_epi8(lut, lo),
+                           _mm256_shuffle_epi8(lut, hi));
+}
+
+template <bool Xor>
+TARGET_AVX2 inline u64 popcount_avx2(const u8* a, const u8* b, u32 num_blocks,
+                                     const BlockMask& mask)
+{
+    const __m256i pattern = load_pattern_avx2(mask);
+
+    __m256i total = _mm256_setzero_si256();
+
+    u32 i = 0;
+    while (i + 2u < num_blocks)
+    {
+        // byte counters grow by up to 8 per step, flush them to the u64
+        // lanes before they overflow (31 * 8 < 256)
+        __m256i   bytes = _mm256_setzero_si256();
+        const u32 end   = std::min(i + 62u, num_blocks - 1u);
+        for (; i + 2u <= end; i += 2u)
+        {
+            const __m256i v =
+                _mm256_and_si256(load_blocks_avx2<Xor>(a, b, i), pattern);
+            bytes = _mm256_add_epi8(bytes, popcount_bytes_avx2(v));
+        }
+        total = _mm256_add_epi64(total,
+                                 _mm256_sad_epu8(bytes, _mm256_setzero_si256()));
+    }
+
+    alignas(32) u64 lanes[4];
+    _mm256_store_si256((__m256i*)lanes, total);
+
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+           popcount_popcnt<Xor>(a + i * 16u, b + i * 16u, num_blocks - i, mask);
+}
+
+template <bool Xor>
+TARGET_AVX2 inline bool is_zero_avx2(const u8* a, const u8* b, u32 num_blocks,
+                                     const BlockMask& mask)
+{
+    const __m256i pattern = load_pattern_avx2(mask);
+
+    __m256i acc = _mm256_setzero_si256();
+
+    u32 i = 0;
+    for (; i + 2u < num_blocks; i += 2u)
+    {
+        acc = _mm256_or_si256(
+            acc, _mm256_and_si256(load_blocks_avx2<Xor>(a, b, i), pattern));
+    }
+
+    return _mm256_testz_si256(acc, acc) &&
+           is_zero_sse2<Xor>(a + i * 16u, b + i * 16u, num_blocks - i, mask);
+}
+
+// ---------------- AVX-512 ----------------
+
+template <EBinaryOp Op>
+TARGET_AVX512 inline __m512i apply_avx512(__m512i a, __m512i b)
+{
+    if constexpr (Op == EBinaryOp::AND)
+    {
+        return _mm512_and_si512(a, b);
+    }
+    else if constexpr (Op == EBinaryOp::OR)
+    {
+        return _mm512_or_si512(a, b);
+    }
+    else if constexpr (Op == EBinaryOp::XOR)
+    {
+        return _mm512_xor_si512(a, b);
+    }
+    else
+    {
+        return _mm512_andnot_si512(b, a);
+    }
+}
+
+TARGET_AVX512 inline __m512i load_pattern_avx512(const BlockMask& mask)
+{
+    return _mm512_broadcast_i32x4(load_mask_sse2(mask.pattern));
+}
+
+template <bool Xor>
+TARGET_AVX512 inline __m512i load_blocks_avx512(const u8* a, const u8* b,
+                                                u32 block)
+{
+    __m512i v = _mm512_loadu_si512(a + block * 16u);
+    if constexpr (Xor)
+    {
+        v = _mm512_xor_si512(v, _mm512_loadu_si512(b + block * 16u));
+    }
+    return v;
+}
+
+template <EBinaryOp Op>
+TARGET_AVX512 inline void binary_avx512(u8* dst, const u8* a, const u8* b,
+                                        u32 num_blocks)
+{
+    u32 i = 0;
+    for (; i + 4u <= num_blocks; i += 4u)
+    {
+        const __m512i va = _mm512_loadu_si512(a + i * 16u);
+        const __m512i vb = _mm512_loadu_si512(b + i * 16u);
+        _mm512_storeu_si512(dst + i * 16u, apply_avx512<Op>(va, vb));
+    }
+
+    if (i < num_blocks)
+    {
+        // u64 lanes of the (up to 3) blocks left
+        const __mmask8 lanes = (__mmask8)((1u << ((num_blocks - i) * 2u)) - 1u);
+        const __m512i  va    = _mm512_maskz_loadu_epi64(lanes, a + i * 16u);
+        const __m512i  vb    = _mm512_maskz_loadu_epi64(lanes, b + i * 16u);
+        _mm512_mask_storeu_epi64(dst + i * 16u, lanes, apply_avx512<Op>(va, vb));
+    }
+}
+
+TARGET_AVX512 inline void not_avx512(u8* dst, const u8* a, u32 num_blocks,
+                                     const BlockMask& mask)
+{
+    const __m512i pattern = load_pattern_avx512(mask);
+
+    u32 i = 0;
+    for (; i + 4u < num_blocks; i += 4u)
+    {
+        const __m512i va = _mm512_loadu_si512(a + i * 16u);
+        _mm512_storeu_si512(dst + i * 16u, _mm512_xor_si512(va, pattern));
+    }
+    not_sse2(dst + i * 16u, a + i * 16u, num_blocks - i, mask);
+}
+
+template <bool Xor>
+TARGET_AVX512_POPCNT inline u64 popcount_avx512(const u8* a, const u8* b,
+                                                u32 num_blocks,
+                                                const BlockMask& mask)
+{
+    const __m512i pattern = load_pattern_avx512(mask);
+
+    __m512i total = _mm512_setzero_si512();
+
+    u32 i = 0;
+    for (; i + 4u < num_blocks; i += 4u)
+    {
+        const __m512i v =
+            _mm512_and_si512(load_blocks_avx512<Xor>(a, b, i), pattern);
+        total = _mm512_add_epi64(total, _mm512_popcnt_epi64(v));
+    }
+
+    return (u64)_mm512_reduce_add_epi64(total) +
+           popcount_popcnt<Xor>(a + i * 16u, b + i * 16u, num_blocks - i, mask);
+}
+
+template <bool Xor>
+TARGET_AVX512 inline bool is_zero_avx512(const u8* a, const u8* b,
+                                         u32 num_blocks, const BlockMask& mask)
+{
+    const __m512i pattern = load_pattern_avx512(mask);
+
+    __m512i acc = _mm512_setzero_si512();
+
+    u32 i = 0;
+    for (; i + 4u < num_blocks; i += 4u)
+    {
+        acc = _mm512_ternarylogic_epi64(acc, load_blocks_avx512<Xor>(a, b, i),
+                                        pattern, 0xf8); // acc | (v & pattern)
+    }
+
+    return _mm512_test_epi64_mask(acc, acc) == 0u &&
+           is_zero_sse2<Xor>(a + i * 16u, b + i * 16u, num_blocks - i, mask);
+}
+
+// 16 bits at a time: VPCOMPRESSD packs the indices of the set ones
+TARGET_AVX512 inline u32 extract_avx512(const BitSpan& span, u32* out)
+{
+    const __m512i iota = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10,
+                                           11, 12, 13, 14, 15);
+
+    u32 num_extracted = 0u;
+    u32 base          = 0u;
+    for (u32 w = 0; w < span.num_words(); w++)
+    {
+        const u64 bits = span.word(w);
+        for (u32 group = 0; bits != 0u && group < 4u; group++)
+        {
+            const __mmask16 group_bits = (__mmask16)(bits >> (group * 16u));
+            if (group_bits == 0u)
+            {
+                continue;
+            }
+
+            const __m512i indices =
+                _mm512_add_epi32(iota, _mm512_set1_epi32((i32)(base + group * 16u)));
+            _mm512_storeu_si512(&out[num_extracted],
+                                _mm512_maskz_compress_epi32(group_bits, indices));
+            num_extracted += (u32)__builtin_popcount(group_bits);
+        }
+        base += span.mask.word_width(w);
+    }
+    return num_extracted;
+}
+
+inline Kernels select_kernels()
+{
+    const Intrinsics::CpuFeatures& cpu = Intrinsics::cpu_features();
+
+    Kernels kernels = {
+        .binary       = {&binary_sse2<EBinaryOp::AND>,
+                         &binary_sse2<EBinaryOp::OR>,
+                         &binary_sse2<EBinaryOp::XOR>,
+                         &binary_sse2<EBinaryOp::ANDNOT>},
+        .bit_not      = &not_sse2,
+        .popcount     = cpu.popcnt ? &popcount_popcnt<false>
+                                   : &popcount_scalar<false>,
+        .popcount_xor = cpu.popcnt ? &popcount_popcnt<true>
+                                   : &popcount_scalar<true>,
+        .is_zero      = &is_zero_sse2<false>,
+        .is_zero_xor  = &is_zero_sse2<true>,
+        .extract      = &extract_scalar,
+    };
+
+    if (cpu.avx2)
+    {
+        kernels.binary[0]    = &binary_avx2<EBinaryOp::AND>;
+        kernels.binary[1]    = &binary_avx2<EBinaryOp::OR>;
+        kernels.binary[2]    = &binary_avx2<EBinaryOp::XOR>;
+        kernels.binary[3]    = &binary_avx2<EBinaryOp::ANDNOT>;
+        kernels.bit_not      = &not_avx2;
+        kernels.popcount     = &popcount_avx2<false>;
+        kernels.popcount_xor = &popcount_avx2<true>;
+        kernels.is_zero      = &is_zero_avx2<false>;
+        kernels.is_zero_xor  = &is_zero_avx2<true>;
+    }
+
+    if (cpu.avx512)
+    {
+        kernels.binary[0]   = &binary_avx512<EBinaryOp::AND>;
+        kernels.binary[1]   = &binary_avx512<EBinaryOp::OR>;
+        kernels.binary[2]   = &binary_avx512<EBinaryOp::XOR>;
+        kernels.binary[3]   = &binary_avx512<EBinaryOp::ANDNOT>;
+        kernels.bit_not     = &not_avx512;
+        kernels.is_zero     = &is_zero_avx512<false>;
+        kernels.is_zero_xor = &is_zero_avx512<true>;
+        kernels.extract     = &extract_avx512;
+    }
+
+    if (cpu.avx512_popcnt)
+    {
+        kernels.popcount     = &popcount_avx512<false>;
+        kernels.popcount_xor = &popcount_avx512<true>;
+    }
+
+    return kernels;
+}
+
+} // namespace Detail
+
+inline const Kernels& kernels()
+{
+    static const Kernels selected = Detail::select_kernels();
+    return selected;
+}
+
+/*
+ * 16 byte mask with the first num_bits bits set (num_bits >= 128 is all ones).
+ */
+inline void block_mask(u32 num_bits, u64 (&out_mask)[2])
+{
+    for (u32 i = 0; i < 2u; i++)
+    {
+        const u32 word_bits = num_bits > i * 64u ? num_bits - i * 64u : 0u;
+        out_mask[i] = word_bits >= 64u ? ~0ull : ((1ull << word_bits) - 1ull);
+    }
+}
+
+} // namespace BitOps
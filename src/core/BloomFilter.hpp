@@ -0,0 +1,244 @@
+#pragma once
+
+#include "Allocators.hpp"
+#include "BitList.hpp"
+#include "Containers.hpp"
+#include "Hash.hpp"
+#include "Intrinsics.hpp"
+#include "core.hpp"
+
+#include <cmath>
+#include <immintrin.h>
+
+/*
+ * Blocked (split block) Bloom filter.
+ *
+ * Every key maps to a single 256 bit block (8 u32 words, two blocks per cache
+ * line) and sets one bit in each of the block's words, so a lookup touches one
+ * cache line. On CPUs with AVX2 the 8 probes are computed at once in a
+ * register, the kernel is picked when the filter is created.
+ *
+ * Keys are u64 values (handles, ids or hashes), they get mixed before use.
+ */
+class BloomFilter final
+{
+  public:
+    using Block = BitList<256u, u32>;
+
+    static constexpr u32 WordsPerBlock  = Block::NumWords;
+    static constexpr u32 BlockAlignment = 64u;
+
+    static_assert(WordsPerBlock == 8u, "probe salts assume 8 words a block");
+
+  public:
+    Block* blocks     = nullptr;
+    u32    num_blocks = 0u;
+    bool   use_avx2   = Intrinsics::cpu_features().avx2;
+
+    IAllocator&  _Allocator;
+    MemoryHandle memory_handle;
+
+  public:
+    /*
+     * Sizes the filter so that after inserting expected_elements keys a
+     * lookup of a missing key has false_positive_rate odds of passing.
+     */
+    explicit BloomFilter(IAllocator& allocator, u32 expected_elements,
+                         float false_positive_rate = 0.01f)
+        : _Allocator(allocator)
+    {
+        assert(false_positive_rate > 0.0f && false_positive_rate < 1.0f);
+
+        num_blocks = blocks_for_rate(expected_elements, false_positive_rate);
+        memory_handle = _Allocator.CreateArray<Block, BlockAlignment>(
+            blocks, num_blocks);
+        assert(memory_handle.is_valid());
+    }
+
+    BloomFilter(const BloomFilter&) = delete;
+
+    ~BloomFilter() { _Allocator.Free(memory_handle); }
+
+    void clear()
+    {
+        for (u32 i = 0; i < num_blocks; i++)
+        {
+            blocks[i] = Block();
+        }
+    }
+
+    inline void insert(u64 key)
+    {
+        const u64 hash  = mix(key);
+        Block&    block = blocks[block_index(hash)];
+
+        if (use_avx2)
+        {
+            insert_avx2(block, (u32)hash);
+            return;
+        }
+
+        for (u32 i = 0; i < WordsPerBlock; i++)
+        {
+            block.set_bit(i * Block::BitsPerWord + probe_bit((u32)hash, i));
+        }
+    }
+
+    /*
+     * False means the key was never inserted, true means it probably was.
+     */
+    [[nodiscard]] inline bool maybe_contains(u64 key) const
+    {
+        const u64    hash  = mix(key);
+        const Block& block = blocks[block_index(hash)];
+
+        if (use_avx2)
+        {
+            return contains_avx2(block, (u32)hash);
+        }
+
+        for (u32 i = 0; i < WordsPerBlock; i++)
+        {
+            if (!block[i * Block::BitsPerWord + probe_bit((u32)hash, i)])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void insert_batch(View<const u64> keys)
+    {
+        for (u32 i = 0; i < keys.NumElements; i++)
+        {
+            insert(keys[i]);
+        }
+    }
+
+    /*
+     * Writes 1 for every key that may be in the set, 0 otherwise. Block
+     * addresses are computed and prefetched a group ahead so the misses of
+     * a group overlap. Returns the number of possible hits.
+     */
+    u32 query_batch(View<const u64> keys, View<u8> out_results) const
+    {
+        assert(out_results.NumElements >= keys.NumElements);
+
+        constexpr u32 GroupSize = 8u;
+
+        u32 num_hits = 0u;
+        for (u32 group = 0; group < keys.NumElements; group += GroupSize)
+        {
+            const u32 group_end =
+                std::min(group + GroupSize, keys.NumElements);
+            const u32 prefetch_end =
+                std::min(group_end + GroupSize, keys.NumElements);
+
+            for (u32 i = group_end; i < prefetch_end; i++)
+            {
+                __builtin_prefetch(&blocks[block_index(mix(keys[i]))]);
+            }
+
+            for (u32 i = group; i < group_end; i++)
+            {
+                const u8 hit   = maybe_contains(keys[i]) ? 1u : 0u;
+                out_results[i] = hit;
+                num_hits += hit;
+            }
+        }
+
+        return num_hits;
+    }
+
+    size_t size_bytes() const { return num_blocks * sizeof(Block); }
+
+    /*
+     * Expected false positive rate of a split block filter with the given
+     * number of blocks holding num_elements keys. The keys per block follow a
+     * poisson distribution, a block holding i keys has a
+     * (1 - (1 - 1/32)^i)^8 false positive rate.
+     */
+    static double false_positive_rate(u32 num_elements, u32 num_blocks)
+    {
+        const double lambda = (double)num_elements / (double)num_blocks;
+        const u32    max_i  = (u32)(lambda + 10.0 * std::sqrt(lambda) + 20.0);
+
+        const double bit_unset = 1.0 - 1.0 / (double)Block::BitsPerWord;
+
+        double rate        = 0.0;
+        double probability = std::exp(-lambda); // poisson(i = 0)
+        for (u32 i = 0; i <= max_i; i++)
+        {
+            const double block_rate =
+                std::pow(1.0 - std::pow(bit_unset, (double)i), WordsPerBlock);
+            rate += probability * block_rate;
+            probability *= lambda / (double)(i + 1u);
+        }
+        return rate;
+    }
+
+  private:
+    static u32 blocks_for_rate(u32 num_elements, float rate)
+    {
+        if (num_elements == 0u)
+        {
+            return 1u;
+        }
+
+        // classic bloom filter size as a starting point, then grow until the
+        // blocked layout reaches the requested rate
+        const double ln2      = 0.6931471805599453;
+        const double num_bits =
+            -(double)num_elements * std::log((double)rate) / (ln2 * ln2);
+
+        u32 result = std::max(1u, (u32)(num_bits / Block::NumBits));
+        while (false_positive_rate(num_elements, result) > rate)
+        {
+            result += std::max(1u, result / 16u);
+        }
+        return result;
+    }
+
+    // spreads handle/index like keys over all bits
+    static inline u64 mix(u64 key) { return hash_mix(key); }
+
+    // high half of the hash picks the block, without a modulo
+    inline u32 block_index(u64 hash) const
+    {
+        return (u32)(((hash >> 32) * (u64)num_blocks) >> 32);
+    }
+
+    // odd multipliers, one per word, that derive the probes from the low half
+    static constexpr u32 ProbeSalts[WordsPerBlock] = {
+        0x47b6137bu, 0x44974d91u, 0x8824ad5bu, 0xa2b7289du,
+        0x705495c7u, 0x2df1424bu, 0x9efc4947u, 0x5c6bfb31u,
+    };
+
+    static inline u32 probe_bit(u32 hash, u32 word)
+    {
+        return (hash * ProbeSalts[word]) >> 27;
+    }
+
+    // probe_bit of all 8 words at once, as a mask per word
+    TARGET_AVX2 static inline __m256i probe_mask(u32 hash)
+    {
+        const __m256i salts = _mm256_loadu_si256((const __m256i*)ProbeSalts);
+
+        __m256i bits = _mm256_mullo_epi32(_mm256_set1_epi32((i32)hash), salts);
+        bits         = _mm256_srli_epi32(bits, 27);
+        return _mm256_sllv_epi32(_mm256_set1_epi32(1), bits);
+    }
+
+    TARGET_AVX2 static inline void insert_avx2(Block& block, u32 hash)
+    {
+        __m256i* words = (__m256i*)block.data;
+        _mm256_store_si256(words, _mm256_or_si256(_mm256_load_si256(words),
+                                                  probe_mask(hash)));
+    }
+
+    TARGET_AVX2 static inline bool contains_avx2(const Block& block, u32 hash)
+    {
+        return _mm256_testc_si256(_mm256_load_si256((const __m256i*)block.data),
+                                  probe_mask(hash));
+    }
+};
@@ -0,0 +1,369 @@
+#pragma once
+
+#include "Allocators.hpp"
+#include "AtomicBitList.hpp"
+#include "Pool.hpp"
+#include "core.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <utility>
+
+/*
+ * ConcurrentPool
+ *
+ * Pool that any number of threads can add to, remove from and look up in at
+ * the same time, with the same handles as Pool.
+ *
+ * Slots live in fixed size chunks that never move, so growing (allocating
+ * one more chunk) doesn't invalidate concurrent readers. Every chunk has an
+ * atomic bit set of used slots that add_element claims from without a lock,
+ * only allocating a new chunk takes a mutex. Generations are atomic:
+ * remove_element bumps the generation with a CAS, so of two threads removing
+ * the same handle only one succeeds, and is_handle_valid/get_element are
+ * wait-free (a few loads, no retries).
+ *
+ * The pool doesn't keep a removed slot's object alive: a thread still using
+ * a reference to it while another thread removes and re-adds the slot reads
+ * the new object. Objects that may still be in use (e.g. by in-flight GPU
+ * frames) are removed with remove_element_deferred.
+ *
+ * Slots that were added, updated or freed are marked in per chunk atomic
+ * dirty bits, consume_dirty() hands them out once (descriptor updates). A
+ * claimed slot is only published to get_slot() through its ready bit once
+ * its object is stored.
+ *
+ * The allocator is only used under the pool's mutex, but it is not
+ * synchronized with other users of the same allocator.
+ */
+template <typename T, typename PoolHandleT, u32 ChunkSlots = 4096u>
+    requires is_power_of_two_v<ChunkSlots>
+class ConcurrentPool
+{
+  public:
+    static constexpr u32 MaxChunks = (PoolHandleT::MAX_INDEX + 1u) / ChunkSlots;
+
+    struct Chunk
+    {
+        MemoryHandle              memory_handle;
+        AtomicBitList<ChunkSlots> used;
+        AtomicBitList<ChunkSlots> ready; // object stored, see get_slot
+        AtomicBitList<ChunkSlots> dirty;
+        std::atomic<u32>          generations[ChunkSlots] = {};
+        T                         objects[ChunkSlots];
+    };
+
+  public:
+    [[nodiscard]] explicit ConcurrentPool(IAllocator& allocator, u32 start_size)
+        : pending_removals(allocator), _Allocator(allocator)
+    {
+        const u32 start_chunks =
+            std::max((start_size + ChunkSlots - 1u) / ChunkSlots, 1u);
+        for (u32 i = 0; i < start_chunks; i++)
+        {
+            chunks[i].store(allocate_chunk(i), std::memory_order_relaxed);
+        }
+        num_chunks.store(start_chunks, std::memory_order_release);
+
+        // index 0 is never handed out, it's the null handle
+        chunks[0].load(std::memory_order_relaxed)->used.try_set(0u);
+    }
+
+    ConcurrentPool(const ConcurrentPool&)            = delete;
+    ConcurrentPool& operator=(const ConcurrentPool&) = delete;
+
+    ~ConcurrentPool()
+    {
+        const u32 count = num_chunks.load(std::memory_order_acquire);
+        for (u32 i = 0; i < count; i++)
+        {
+            Chunk*             chunk  = chunks[i].load(std::memory_order_relaxed);
+            const MemoryHandle handle = chunk->memory_handle;
+            chunk->~Chunk();
+            _Allocator.Free(handle);
+        }
+    }
+
+    /*
+     * Threads passing different thread_index values start looking for a free
+     * slot in different chunks, and at different cache lines of the chunk's
+     * used bits.
+     */
+    [[nodiscard]] PoolHandleT add_element(T&& elem, u32 thread_index = 0u)
+    {
+        const u32 hint = Detail::atomic_bits_thread_hint(
+            AtomicBitList<ChunkSlots>::NumWords, thread_index % UsedBitsLines,
+            UsedBitsLines);
+
+        for (;;)
+        {
+            const u32 count       = num_chunks.load(std::memory_order_acquire);
+            const u32 first_chunk = thread_index % count;
+
+            for (u32 i = 0; i < count; i++)
+            {
+                const u32 chunk_idx =
+                    first_chunk + i < count ? first_chunk + i : first_chunk + i - count;
+
+                Chunk*    chunk = chunks[chunk_idx].load(std::memory_order_acquire);
+                const i32 slot  = chunk->used.claim_first_free(hint);
+                if (slot < 0)
+                {
+                    continue;
+                }
+
+                chunk->objects[slot] = std::move(elem);
+                chunk->ready.try_set((u32)slot); // release, publishes the object
+                mark_dirty(chunk, (u32)slot);
+
+                const u32 index = chunk_idx * ChunkSlots + (u32)slot;
+                const u32 gen =
+                    chunk->generations[slot].load(std::memory_order_relaxed);
+                return {index, gen};
+            }
+
+            grow(count);
+        }
+    }
+
+    /*
+     * Returns false if the handle was already removed (possibly by another
+     * thread at the same time).
+     */
+    bool remove_element(const PoolHandleT& handle)
+    {
+        if (!invalidate(handle))
+        {
+            return false;
+        }
+
+        free_slot(handle.index);
+        return true;
+    }
+
+    /*
+     * Invalidates the handle right away, the slot is freed by the first
+     * release_completed() call with a completed frame >= frame. Unlike
+     * Pool's, the frames may arrive out of order from different threads.
+     */
+    bool remove_element_deferred(const PoolHandleT& handle, u64 frame)
+    {
+        if (!invalidate(handle))
+        {
+            return false;
+        }
+
+        std::lock_guard lock(mutex);
+        pending_removals.add_no_init(1u);
+        pending_removals[pending_removals.NumElements - 1u] = {handle.index, frame};
+        return true;
+    }
+
+    u32 release_completed(u64 completed_frame)
+    {
+        std::lock_guard lock(mutex);
+
+        u32 num_kept = 0u;
+        for (u32 i = 0; i < pending_removals.NumElements; i++)
+        {
+            const PendingRemoval removal = pending_removals[i];
+            if (removal.frame <= completed_frame)
+            {
+                free_slot(removal.index);
+            }
+            else
+            {
+                pending_removals[num_kept++] = removal;
+            }
+        }
+
+        const u32 num_released       = pending_removals.NumElements - num_kept;
+        pending_removals.NumElements = num_kept;
+        return num_released;
+    }
+
+    /*
+     * Replaces the element, the caller must be the only thread using the
+     * handle while it does.
+     */
+    void update_element(const PoolHandleT& handle, T&& new_elem)
+    {
+        if (!is_handle_valid(handle))
+        {
+            return;
+        }
+
+        Chunk*    chunk = chunk_of(handle.index);
+        const u32 slot  = handle.index % ChunkSlots;
+
+        chunk->objects[slot] = std::move(new_elem);
+        mark_dirty(chunk, slot);
+    }
+
+    /*
+     * Element in the slot, whatever its generation (the slot of a deferred
+     * removal still has its object), nullptr for free slots and slots whose
+     * object is still being stored by add_element.
+     */
+    inline const T* get_slot(u32 index) const
+    {
+        if (!is_index_valid(index))
+        {
+            return nullptr;
+        }
+
+        const Chunk* chunk = chunk_of(index);
+        const u32    slot  = index % ChunkSlots;
+        return chunk->ready[slot] ? &chunk->objects[slot] : nullptr; // acquire
+    }
+
+    /*
+     * Calls func(u32 slot) for every slot added, updated or freed since the
+     * last call, in increasing order. Each dirty bit is taken with an atomic
+     * exchange of its word, so changes made while this runs are either
+     * handed out now or by the next call.
+     */
+    template <typename FuncT>
+    void consume_dirty(FuncT&& func)
+    {
+        const u32 count = num_chunks.load(std::memory_order_acquire);
+        for (u32 chunk_idx = 0; chunk_idx < count; chunk_idx++)
+        {
+            Chunk* chunk = chunks[chunk_idx].load(std::memory_order_acquire);
+            for (u32 w = 0; w < AtomicBitList<ChunkSlots>::NumWords; w++)
+            {
+                if (chunk->dirty.words[w].load(std::memory_order_relaxed) == 0u)
+                {
+                    continue;
+                }
+
+                u64 bits =
+                    chunk->dirty.words[w].exchange(0u, std::memory_order_acq_rel);
+                for (; bits != 0u; bits &= bits - 1u)
+                {
+                    func(chunk_idx * ChunkSlots + w * 64u +
+                         (u32)__builtin_ctzll(bits));
+                }
+            }
+        }
+    }
+
+    inline bool is_handle_valid(const PoolHandleT& handle) const
+    {
+        return is_index_valid(handle.index) &&
+               chunk_of(handle.index)
+                       ->generations[handle.index % ChunkSlots]
+                       .load(std::memory_order_acquire) == handle.gen;
+    }
+
+    inline T& get_element(const PoolHandleT& handle)
+    {
+        assert(is_handle_valid(handle));
+        return chunk_of(handle.index)->objects[handle.index % ChunkSlots];
+    }
+
+    inline const T& get_element(const PoolHandleT& handle) const
+    {
+        assert(is_handle_valid(handle));
+        return chunk_of(handle.index)->objects[handle.index % ChunkSlots];
+    }
+
+    // Slots available without growing
+    inline u32 capacity() const
+    {
+        return num_chunks.load(std::memory_order_acquire) * ChunkSlots;
+    }
+
+  public:
+    std::atomic<Chunk*> chunks[MaxChunks] = {};
+    std::atomic<u32>    num_chunks        = 0u;
+
+    Array<PendingRemoval> pending_removals; // guarded by mutex
+
+  private:
+    // cache lines of a chunk's used bits, one start hint per line
+    static constexpr u32 UsedBitsLines =
+        (AtomicBitList<ChunkSlots>::NumWords + 7u) / 8u;
+
+    inline bool is_index_valid(u32 index) const
+    {
+        return index > 0u &&
+               index / ChunkSlots < num_chunks.load(std::memory_order_acquire);
+    }
+
+    // Bumps the generation, false if the handle was already invalid. The
+    // slot stays used (and ready) until free_slot.
+    bool invalidate(const PoolHandleT& handle)
+    {
+        if (!is_index_valid(handle.index))
+        {
+            return false;
+        }
+
+        Chunk*    chunk = chunk_of(handle.index);
+        const u32 slot  = handle.index % ChunkSlots;
+
+        u32 gen = handle.gen;
+        if (!chunk->generations[slot].compare_exchange_strong(
+                gen, (gen + 1u) % PoolHandleT::MAX_GEN, std::memory_order_acq_rel,
+                std::memory_order_relaxed))
+        {
+            return false;
+        }
+        return true;
+    }
+
+    // Unpublishes the object before the slot can be claimed again
+    inline void free_slot(u32 index)
+    {
+        Chunk*    chunk = chunk_of(index);
+        const u32 slot  = index % ChunkSlots;
+
+        chunk->ready.unset_bit(slot);
+        mark_dirty(chunk, slot);
+        chunk->used.unset_bit(slot);
+    }
+
+    static inline void mark_dirty(Chunk* chunk, u32 slot)
+    {
+        // already dirty is fine, it's handed out once either way
+        chunk->dirty.try_set(slot);
+    }
+
+    inline Chunk* chunk_of(u32 index) const
+    {
+        return chunks[index / ChunkSlots].load(std::memory_order_acquire);
+    }
+
+    Chunk* allocate_chunk(u32 chunk_idx)
+    {
+        assert(chunk_idx < MaxChunks && "pool is out of handle indices");
+
+        const MemoryHandle handle = _Allocator.Allocate(
+            sizeof(Chunk), {true, std::max<u32>(alignof(Chunk), 64u)});
+        assert(handle.is_valid());
+
+        Chunk* chunk         = new (_Allocator.HandleToPtr(handle)) Chunk();
+        chunk->memory_handle = handle;
+        return chunk;
+    }
+
+    // Adds a chunk unless another thread already did since seen_count was read
+    void grow(u32 seen_count)
+    {
+        std::lock_guard lock(mutex);
+
+        const u32 count = num_chunks.load(std::memory_order_relaxed);
+        if (count != seen_count)
+        {
+            return;
+        }
+
+        chunks[count].store(allocate_chunk(count), std::memory_order_release);
+        num_chunks.store(count + 1u, std::memory_order_release);
+    }
+
+    IAllocator& _Allocator;
+    std::mutex  mutex; // chunk allocation and pending_removals
+};
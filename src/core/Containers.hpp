@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Allocators.hpp"
+#include "Intrinsics.hpp"
 #include "core.hpp"
 
 #include <algorithm>
@@ -9,11 +10,15 @@
 #include <initializer_list>
 #include <type_traits>
 
-template <typename T>
+/*
+ * SizeT selects the width of sizes and indices, u32 by default. Use the
+ * View64/Array64 aliases for data that can go past 2^32 elements.
+ */
+template <typename T, typename SizeT = u32>
 struct View
 {
-    T*        Data;
-    const u32 NumElements;
+    T*          Data;
+    const SizeT NumElements;
 
     inline T* begin() { return &Data[0]; }
     inline T* end() { return &Data[NumElements - 1]; }
@@ -21,19 +26,61 @@ struct View
     inline const T* begin() const { return &Data[0]; }
     inline const T* end() const { return &Data[NumElements - 1]; }
 
-    inline const T& operator[](const u32 _idx) const
+    inline const T& operator[](const SizeT _idx) const
     {
         assert(_idx < NumElements);
         return Data[_idx];
     }
 
-    inline T& operator[](const u32 _idx)
+    inline T& operator[](const SizeT _idx)
     {
         assert(_idx < NumElements);
         return Data[_idx];
     }
 };
 
+template <typename T>
+using View64 = View<T, u64>;
+
+/*
+ * View over elements that are Stride bytes apart, e.g. one member of every
+ * struct in an array (see CreateStridedView).
+ */
+template <typename T>
+struct StridedView
+{
+    using ByteT = std::conditional_t<std::is_const_v<T>, const u8, u8>;
+
+    T*        Data;
+    const u32 Stride;
+    const u32 NumElements;
+
+    inline const T& operator[](const u32 _idx) const
+    {
+        assert(_idx < NumElements);
+        return *reinterpret_cast<T*>(reinterpret_cast<ByteT*>(Data) +
+                                     (size_t)_idx * Stride);
+    }
+
+    inline T& operator[](const u32 _idx)
+    {
+        assert(_idx < NumElements);
+        return *reinterpret_cast<T*>(reinterpret_cast<ByteT*>(Data) +
+                                     (size_t)_idx * Stride);
+    }
+
+    inline operator StridedView<const T>() const
+        requires(!std::is_const_v<T>)
+    {
+        StridedView<const T> Result = {
+            .Data        = Data,
+            .Stride      = Stride,
+            .NumElements = NumElements,
+        };
+        return Result;
+    }
+};
+
 template <typename T, u32 N>
     requires std::is_default_constructible_v<T>
 class StaticArray final
@@ -94,47 +141,49 @@ class StaticArray final
     operator View<T>() { return CreateView(*this); }
 };
 
-template <typename T>
+template <typename T, typename SizeT = u32>
 class Array final
 {
   public:
     static constexpr u32 ElemSize = sizeof(T);
 
   public:
-    T*  Data        = nullptr;
-    u32 NumElements = 0;
+    T*    Data        = nullptr;
+    SizeT NumElements = 0;
 
-    u32          _NumAllocated = 0;
+    SizeT        _NumAllocated = 0;
     IAllocator&  _Allocator;
     MemoryHandle memory_handle;
 
-    explicit Array(IAllocator& allocator, u32 reservedNum = 0)
+    explicit Array(IAllocator& allocator, SizeT reservedNum = 0)
         : _Allocator(allocator)
     {
         if (reservedNum > 0)
         {
-            memory_handle = _Allocator.CreateArray<T>(&Data, reservedNum);
-            _NumAllocated = round_up_pow2(reservedNum);
+            const SizeT alloc_size = round_up_pow2(reservedNum);
+
+            memory_handle = _Allocator.CreateArray<T>(Data, alloc_size);
+            _NumAllocated = alloc_size;
         }
     }
 
     Array(IAllocator& allocator, std::initializer_list<T> initList)
         : _Allocator(allocator)
     {
-        const u32 alloc_size = round_up_pow2(initList.size());
+        const SizeT alloc_size = round_up_pow2((SizeT)initList.size());
 
-        memory_handle = _Allocator.CreateArray<T>(&Data, alloc_size);
+        memory_handle = _Allocator.CreateArray<T>(Data, alloc_size);
         memcpy(Data, initList.begin(), initList.size() * ElemSize);
 
         _NumAllocated = alloc_size;
         NumElements = initList.size();
     }
 
-    Array(const Array<T>& array) : _Allocator(array._Allocator)
+    Array(const Array<T, SizeT>& array) : _Allocator(array._Allocator)
     {
-    	const u32 alloc_size = round_up_pow2(array.NumElements);
+    	const SizeT alloc_size = round_up_pow2(array.NumElements);
 
-        memory_handle = _Allocator.CreateArray<T>(&Data, alloc_size);
+        memory_handle = _Allocator.CreateArray<T>(Data, alloc_size);
         memcpy(Data, array.Data, array.NumElements * ElemSize);
 
         NumElements   = array.NumElements;
@@ -143,15 +192,15 @@ class Array final
 
     ~Array() { _Allocator.Free(memory_handle); }
 
-    u32 Size() const { return NumElements; }
+    SizeT Size() const { return NumElements; }
 
-    void Resize(u32 newSize)
+    void Resize(SizeT newSize)
     {
-        const u32 new_size_pow2 = round_up_pow2(newSize);
+        const SizeT new_size_pow2 = round_up_pow2(newSize);
 
         T*           temp = nullptr;
         MemoryHandle new_memory =
-            _Allocator.CreateArray<T>(&temp, new_size_pow2);
+            _Allocator.CreateArray<T>(temp, new_size_pow2);
         assert(new_memory.is_valid());
 
         // copy over old data to new        // allocator?
@@ -163,7 +212,7 @@ class Array final
         _NumAllocated = new_size_pow2;
     }
 
-    void Reserve(u32 newAmount)
+    void Reserve(SizeT newAmount)
     {
         assert(newAmount != 0u);
 
@@ -173,14 +222,14 @@ class Array final
         }
     }
 
-    void add_no_init(u32 amount)
+    void add_no_init(SizeT amount)
     {
-    	const u32 requested_size = NumElements + amount;
+    	const SizeT requested_size = NumElements + amount;
     	Reserve(requested_size);
     	NumElements = requested_size;
     }
 
-    u32 Add(const T& elem)
+    SizeT Add(const T& elem)
     {
         if (NumElements >= _NumAllocated - 1)
         {
@@ -193,7 +242,7 @@ class Array final
     }
 
     template <class... Args>
-    u32 Emplace(Args&&... args)
+    SizeT Emplace(Args&&... args)
     {
         if (NumElements >= _NumAllocated - 1)
         {
@@ -206,7 +255,7 @@ class Array final
     }
 
     template <class... Args>
-    void EmplaceAt(u32 index, Args&&... args)
+    void EmplaceAt(SizeT index, Args&&... args)
     {
         assert(index < _NumAllocated);
 
@@ -218,7 +267,7 @@ class Array final
         if (_NumAllocated > NumElements)
         {
             // Move the allocation to a perfect fit size
-            MemoryHandle new_handle = _Allocator.CreateArray<T>(&Data, NumElements);
+            MemoryHandle new_handle = _Allocator.CreateArray<T>(Data, NumElements);
             memcpy(_Allocator.HandleToPtr(new_handle), _Allocator.HandleToPtr(memory_handle), NumElements * ElemSize);
 
             _Allocator.Free(memory_handle);
@@ -228,9 +277,9 @@ class Array final
         }
     }
 
-    void Append(View<const T> view)
+    void Append(View<const T, SizeT> view)
     {
-        const u32 new_size = NumElements + view.NumElements;
+        const SizeT new_size = NumElements + view.NumElements;
         if (new_size > _NumAllocated)
         {
             Resize(new_size);
@@ -243,19 +292,19 @@ class Array final
 
     // ---------------- Operator overloads  ----------------
 
-    const T& operator[](const u32 index) const
+    const T& operator[](const SizeT index) const
     {
         assert(index <= NumElements);
         return Data[index];
     }
 
-    T& operator[](const u32 index)
+    T& operator[](const SizeT index)
     {
         assert(index <= NumElements);
         return Data[index];
     }
 
-    void operator=(View<T> view)
+    void operator=(View<T, SizeT> view)
     {
         if (_NumAllocated < view.NumElements)
         {
@@ -266,7 +315,7 @@ class Array final
         NumElements = view.NumElements;
     }
 
-    void operator=(const Array<T>& array)
+    void operator=(const Array<T, SizeT>& array)
     {
         if (_NumAllocated < array._NumAllocated)
         {
@@ -281,7 +330,7 @@ class Array final
     {
         if (_NumAllocated < list.size())
         {
-            Resize(list.size());
+            Resize((SizeT)list.size());
         }
         memcpy(Data, list.begin(), list.size() * ElemSize);
         NumElements = list.size();
@@ -304,10 +353,13 @@ class Array final
     T* end() { return &Data[NumElements]; }
 
     // ---------------- Implicit casts to views ----------------
-    operator View<T>() const { return CreateConstView(*this); }
-    operator View<T>() { return CreateView(*this); }
+    operator View<T, SizeT>() const { return CreateConstView(*this); }
+    operator View<T, SizeT>() { return CreateView(*this); }
 };
 
+template <typename T>
+using Array64 = Array<T, u64>;
+
 template <typename T, u32 N>
 constexpr inline View<T> CreateView(StaticArray<T, N>& array, u32 size = N,
                                     u32 startIndex = 0)
@@ -330,37 +382,81 @@ constexpr inline View<const T> CreateView(const StaticArray<T, N>& array,
     return Result;
 }
 
-template <typename T>
-constexpr inline View<T> CreateView(Array<T>& array, u32 size, u32 startIndex)
+template <typename T, typename SizeT>
+constexpr inline View<T, SizeT> CreateView(Array<T, SizeT>& array, SizeT size,
+                                           SizeT startIndex)
 {
-    const u32 size_clamped = std::min(array.NumElements - startIndex, size);
-    View<T> Result = {.Data = &array[startIndex], .NumElements = size_clamped};
+    const SizeT size_clamped = std::min(array.NumElements - startIndex, size);
+    View<T, SizeT> Result = {.Data        = &array[startIndex],
+                             .NumElements = size_clamped};
     return Result;
 }
 
-template <typename T>
-constexpr inline View<const T> CreateConstView(const Array<T>& array, u32 size,
-                                               u32 startIndex)
+template <typename T, typename SizeT>
+constexpr inline View<const T, SizeT>
+CreateConstView(const Array<T, SizeT>& array, SizeT size, SizeT startIndex)
 {
-    const u32 size_clamped = std::min(array.NumElements - startIndex, size);
+    const SizeT size_clamped = std::min(array.NumElements - startIndex, size);
 
-    View<const T> Result = {
+    View<const T, SizeT> Result = {
         .Data        = &array[startIndex],
         .NumElements = size_clamped,
     };
     return Result;
 }
 
-template <typename T>
-constexpr inline View<T> CreateView(Array<T>& array)
+template <typename T, typename SizeT>
+constexpr inline View<T, SizeT> CreateView(Array<T, SizeT>& array)
 {
-    return CreateView(array, array.NumElements, 0u);
+    return CreateView(array, array.NumElements, SizeT(0));
 }
 
-template <typename T>
-constexpr inline View<const T> CreateConstView(const Array<T>& array)
+template <typename T, typename SizeT>
+constexpr inline View<const T, SizeT>
+CreateConstView(const Array<T, SizeT>& array)
+{
+    return CreateConstView(array, array.NumElements, SizeT(0));
+}
+
+// StridedView counts are u32, Array64/View64 sources must fit
+template <typename T, typename SizeT, typename FieldT>
+constexpr inline StridedView<FieldT> CreateStridedView(View<T, SizeT> view,
+                                                       FieldT T::*member)
+{
+    assert(view.NumElements <= SizeT(~0u));
+    StridedView<FieldT> Result = {
+        .Data        = &(view.Data->*member),
+        .Stride      = sizeof(T),
+        .NumElements = (u32)view.NumElements,
+    };
+    return Result;
+}
+
+template <typename T, typename SizeT, typename FieldT>
+constexpr inline StridedView<const FieldT>
+CreateStridedView(View<const T, SizeT> view, FieldT T::*member)
 {
-    return CreateConstView(array, array.NumElements, 0u);
+    assert(view.NumElements <= SizeT(~0u));
+    StridedView<const FieldT> Result = {
+        .Data        = &(view.Data->*member),
+        .Stride      = sizeof(T),
+        .NumElements = (u32)view.NumElements,
+    };
+    return Result;
+}
+
+template <typename T, typename SizeT, typename FieldT>
+constexpr inline StridedView<FieldT> CreateStridedView(Array<T, SizeT>& array,
+                                                       FieldT T::*member)
+{
+    return CreateStridedView(CreateView(array), member);
+}
+
+template <typename T, typename SizeT, typename FieldT>
+constexpr inline StridedView<const FieldT>
+CreateStridedView(const Array<T, SizeT>& array, FieldT T::*member)
+{
+    return CreateStridedView(CreateConstView(array), member);
 }
 
 template <typename T>
@@ -382,3 +478,225 @@ constexpr inline View<const T> CreateView(T* array, u32 size)
     };
     return Result;
 }
+
+/*
+ * SegmentedArray
+ *
+ * Grows by appending fixed size chunks instead of reallocating, so elements
+ * are never copied on growth and pointers to them stay valid for the lifetime
+ * of the container. Only the (small) chunk table is reallocated.
+ *
+ * Each chunk is contiguous, use ChunkView/ForEachChunk to hand runs of
+ * elements to SIMD kernels.
+ */
+template <typename T, u32 ChunkSize = 1024u>
+    requires is_power_of_two_v<ChunkSize>
+class SegmentedArray final
+{
+  public:
+    static constexpr u32 ElemSize   = sizeof(T);
+    static constexpr u32 ChunkShift = Intrinsics::find_lsb(ChunkSize);
+    static constexpr u32 ChunkMask  = ChunkSize - 1u;
+
+  public:
+    u32 NumElements = 0;
+
+    IAllocator&         _Allocator;
+    Array<T*>           chunks;
+    Array<MemoryHandle> chunk_handles;
+
+    explicit SegmentedArray(IAllocator& allocator, u32 reservedNum = 0)
+        : _Allocator(allocator), chunks(allocator, 4u),
+          chunk_handles(allocator, 4u)
+    {
+        if (reservedNum > 0)
+        {
+            Reserve(reservedNum);
+        }
+    }
+
+    SegmentedArray(const SegmentedArray<T, ChunkSize>&) = delete;
+
+    ~SegmentedArray()
+    {
+        for (u32 i = 0; i < chunk_handles.NumElements; i++)
+        {
+            _Allocator.Free(chunk_handles[i]);
+        }
+    }
+
+    u32 Size() const { return NumElements; }
+
+    u32 NumChunks() const { return chunks.NumElements; }
+
+    u32 Capacity() const { return chunks.NumElements * ChunkSize; }
+
+    void Reserve(u32 newAmount)
+    {
+        while (Capacity() < newAmount)
+        {
+            T*           chunk  = nullptr;
+            MemoryHandle handle = _Allocator.CreateArray<T>(chunk, ChunkSize);
+            assert(handle.is_valid());
+
+            chunks.Add(chunk);
+            chunk_handles.Add(handle);
+        }
+    }
+
+    void add_no_init(u32 amount)
+    {
+        const u32 requested_size = NumElements + amount;
+        Reserve(requested_size);
+        NumElements = requested_size;
+    }
+
+    u32 Add(const T& elem)
+    {
+        Reserve(NumElements + 1u);
+
+        *slot(NumElements++) = elem;
+
+        return NumElements;
+    }
+
+    template <class... Args>
+    u32 Emplace(Args&&... args)
+    {
+        Reserve(NumElements + 1u);
+
+        ::new (slot(NumElements++)) T(std::forward<Args>(args)...);
+
+        return NumElements;
+    }
+
+    void Append(View<const T> view)
+    {
+        Reserve(NumElements + view.NumElements);
+
+        // copy chunk by chunk, the destination is only contiguous per chunk
+        u32 copied = 0;
+        while (copied < view.NumElements)
+        {
+            const u32 in_chunk_idx = NumElements & ChunkMask;
+            const u32 num_to_copy =
+                std::min(ChunkSize - in_chunk_idx, view.NumElements - copied);
+
+            memcpy(slot(NumElements), &view.Data[copied],
+                   num_to_copy * ElemSize);
+
+            NumElements += num_to_copy;
+            copied += num_to_copy;
+        }
+    }
+
+    // Keeps the chunks around for reuse
+    void Clear() { NumElements = 0; }
+
+    // ---------------- Chunk wise access ----------------
+
+    View<T> ChunkView(u32 chunk_index)
+    {
+        assert(chunk_index < NumChunks());
+
+        const u32 start_index = chunk_index << ChunkShift;
+        const u32 num_in_chunk =
+            start_index < NumElements
+                ? std::min(ChunkSize, NumElements - start_index)
+                : 0u;
+
+        View<T> Result = {.Data        = chunks[chunk_index],
+                          .NumElements = num_in_chunk};
+        return Result;
+    }
+
+    View<const T> ChunkView(u32 chunk_index) const
+    {
+        assert(chunk_index < NumChunks());
+
+        const u32 start_index = chunk_index << ChunkShift;
+        const u32 num_in_chunk =
+            start_index < NumElements
+                ? std::min(ChunkSize, NumElements - start_index)
+                : 0u;
+
+        View<const T> Result = {.Data        = chunks[chunk_index],
+                                .NumElements = num_in_chunk};
+        return Result;
+    }
+
+    /*
+     * Calls func(View<T>) for every chunk holding at least one element, in
+     * index order.
+     */
+    template <typename Func>
+    void ForEachChunk(Func&& func)
+    {
+        const u32 num_used_chunks = (NumElements + ChunkMask) >> ChunkShift;
+        for (u32 i = 0; i < num_used_chunks; i++)
+        {
+            func(ChunkView(i));
+        }
+    }
+
+    template <typename Func>
+    void ForEachChunk(Func&& func) const
+    {
+        const u32 num_used_chunks = (NumElements + ChunkMask) >> ChunkShift;
+        for (u32 i = 0; i < num_used_chunks; i++)
+        {
+            func(ChunkView(i));
+        }
+    }
+
+    // ---------------- Operator overloads  ----------------
+
+    const T& operator[](const u32 index) const
+    {
+        assert(index < NumElements);
+        return chunks.Data[index >> ChunkShift][index & ChunkMask];
+    }
+
+    T& operator[](const u32 index)
+    {
+        assert(index < NumElements);
+        return *slot(index);
+    }
+
+    // ---------------- Ranged for iteration interface ----------------
+    template <typename OwnerT, typename ElemT>
+    struct TIterator
+    {
+        OwnerT* owner;
+        u32     index;
+
+        ElemT& operator*() const { return (*owner)[index]; }
+
+        TIterator& operator++()
+        {
+            index++;
+            return *this;
+        }
+
+        bool operator!=(const TIterator& other) const
+        {
+            return index != other.index;
+        }
+    };
+
+    using Iterator      = TIterator<SegmentedArray, T>;
+    using ConstIterator = TIterator<const SegmentedArray, const T>;
+
+    Iterator begin() { return {this, 0u}; }
+    Iterator end() { return {this, NumElements}; }
+
+    ConstIterator begin() const { return {this, 0u}; }
+    ConstIterator end() const { return {this, NumElements}; }
+
+  private:
+    inline T* slot(const u32 index)
+    {
+        assert(index < Capacity());
+        return &chunks.Data[index >> ChunkShift][index & ChunkMask];
+    }
+};
@@ -0,0 +1,164 @@
+#pragma once
+
+#include "BitList.hpp"
+#include "Containers.hpp"
+#include "core.hpp"
+
+#include <cstring>
+
+/*
+ * Delta uploads
+ *
+ * Turns a dirty bitset (or the difference of two snapshots) into coalesced
+ * [begin, end) index ranges, then copies just those ranges of a backing
+ * array into a staging buffer:
+ *
+ *  bitlist_ranges(dirty, ranges, 4u);
+ *  StagePosition pos = {};
+ *  while (pos.range < ranges.NumElements)
+ *  {
+ *      pos = stage_ranges(CreateConstView(instances), CreateConstView(ranges),
+ *                         pos, staging_ptr, staging_size, copies);
+ *      // one VkBufferCopy per StagingCopy, submit, reuse the staging buffer
+ *  }
+ *  // clear dirty
+ *
+ * Ranges closer than merge_gap indices are merged: uploading a few clean
+ * elements is cheaper than another copy command.
+ */
+struct BitRange
+{
+    u32 begin;
+    u32 end;
+
+    inline u32 Size() const { return end - begin; }
+};
+
+/*
+ * Appends the ranges of set bits of list to out, returns how many were
+ * added. Ranges already in out aren't merged with the new ones.
+ */
+template <typename ListT>
+inline u32 bitlist_ranges(const ListT& list, Array<BitRange>& out,
+                          u32 merge_gap = 0u)
+{
+    const BitOps::BitSpan span  = bitlist_span(list);
+    const u32             first = out.NumElements;
+
+    const auto append = [&](u32 begin, u32 end)
+    {
+        if (out.NumElements > first &&
+            begin - out.Data[out.NumElements - 1u].end <= merge_gap)
+        {
+            out.Data[out.NumElements - 1u].end = end;
+            return;
+        }
+        out.add_no_init(1u);
+        out.Data[out.NumElements - 1u] = {begin, end};
+    };
+
+    u32 base = 0u;
+    for (u32 w = 0; w < span.num_words(); w++)
+    {
+        u64 bits = span.word(w);
+        while (bits != 0u)
+        {
+            const u32 start = (u32)__builtin_ctzll(bits);
+            const u64 rest  = ~(bits >> start);
+            const u32 len   = rest == 0u ? 64u - start : (u32)__builtin_ctzll(rest);
+
+            // runs crossing words end up adjacent and are merged by append
+            append(base + start, base + start + len);
+
+            bits = start + len >= 64u ? 0u : bits & (~0ull << (start + len));
+        }
+        base += span.mask.word_width(w);
+    }
+
+    return out.NumElements - first;
+}
+
+/*
+ * Ranges of the bits that differ between two snapshots.
+ */
+template <u32 N>
+inline u32 bitlist_changed_ranges(const BitList<N>& a, const BitList<N>& b,
+                                  Array<BitRange>& out, u32 merge_gap = 0u)
+{
+    return bitlist_ranges(bitlist_changed(a, b), out, merge_gap);
+}
+
+/*
+ * One copy from the staging buffer to the destination buffer, in bytes.
+ */
+struct StagingCopy
+{
+    u64 staging_offset;
+    u64 dst_offset;
+    u64 size;
+};
+
+/*
+ * Where stage_ranges stopped: elements before ranges[range].begin + offset
+ * are staged. All ranges are done once range == ranges.NumElements.
+ */
+struct StagePosition
+{
+    u32 range  = 0u;
+    u32 offset = 0u;
+};
+
+/*
+ * Copies the elements of src covered by ranges (clamped to src), starting at
+ * start, back to back into staging, and appends a StagingCopy per (part of a)
+ * range. A range that doesn't fit in what is left of staging_size bytes is
+ * split, so every call makes progress as long as one element fits. Returns
+ * the position to pass to the next call.
+ */
+template <typename T>
+StagePosition stage_ranges(View<const T> src, View<const BitRange> ranges,
+                           StagePosition start, u8* staging, u64 staging_size,
+                           Array<StagingCopy>& copies)
+{
+    assert(staging_size >= sizeof(T) && "staging can't hold a single element");
+
+    u64           offset = 0u;
+    StagePosition pos    = start;
+
+    for (; pos.range < ranges.NumElements; pos.range++, pos.offset = 0u)
+    {
+        const BitRange& range = ranges.Data[pos.range];
+        const u32       begin = range.begin + pos.offset;
+        const u32       end   = std::min(range.end, src.NumElements);
+        if (begin >= end)
+        {
+            continue;
+        }
+
+        const u32 num_fitting = (u32)std::min<u64>(
+            end - begin, (staging_size - offset) / sizeof(T));
+        if (num_fitting == 0u)
+        {
+            break;
+        }
+
+        const u64 size = (u64)num_fitting * sizeof(T);
+        memcpy(staging + offset, &src.Data[begin], size);
+        copies.add_no_init(1u);
+        copies.Data[copies.NumElements - 1u] = {
+            .staging_offset = offset,
+            .dst_offset     = (u64)begin * sizeof(T),
+            .size           = size,
+        };
+        offset += size;
+
+        if (begin + num_fitting < end)
+        {
+            // staging is full, resume inside this range
+            pos.offset += num_fitting;
+            break;
+        }
+    }
+
+    return pos;
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+#include "Algorithms/Search.hpp"
+#include "Allocators.hpp"
+#include "Containers.hpp"
+#include "core.hpp"
+
+#include <cstring>
+#include <functional>
+#include <type_traits>
+
+/*
+ * FlatMap
+ *
+ * Sorted map over two parallel arrays (keys and values). Lookups are a binary
+ * search over a contiguous key array and iteration is a linear walk, so this
+ * is the map to use for small, mostly read maps. Inserts and removes in the
+ * middle move the tail of both arrays.
+ *
+ * Keys and values are copied with memcpy and must be trivially copyable.
+ */
+template <typename K, typename V, typename LessT = std::less<>>
+    requires std::is_trivially_copyable_v<K> && std::is_trivially_copyable_v<V>
+class FlatMap final
+{
+  public:
+    Array<K> keys;
+    Array<V> values;
+
+  public:
+    explicit FlatMap(IAllocator& allocator, u32 reservedNum = 4u)
+        : keys(allocator, reservedNum), values(allocator, reservedNum)
+    {
+    }
+
+    u32 Size() const { return keys.NumElements; }
+
+    void Clear()
+    {
+        keys.NumElements   = 0;
+        values.NumElements = 0;
+    }
+
+    /*
+     * Inserts or overwrites the value of key. Returns true if the key was new.
+     */
+    bool Insert(const K& key, const V& value)
+    {
+        const u32 index = LowerBound(key);
+        if (index < Size() && is_equal(keys[index], key))
+        {
+            values[index] = value;
+            return false;
+        }
+
+        insert_at(keys, index, key);
+        insert_at(values, index, value);
+        return true;
+    }
+
+    bool Remove(const K& key)
+    {
+        const i32 index = Find(key);
+        if (index < 0)
+        {
+            return false;
+        }
+
+        remove_at(keys, (u32)index);
+        remove_at(values, (u32)index);
+        return true;
+    }
+
+    /*
+     * Returns the index of key, -1 if it is not part of the map.
+     */
+    [[nodiscard]] i32 Find(const K& key) const
+    {
+        const u32 index = LowerBound(key);
+        if (index < Size() && is_equal(keys[index], key))
+        {
+            return (i32)index;
+        }
+        return -1;
+    }
+
+    [[nodiscard]] V* Get(const K& key)
+    {
+        const i32 index = Find(key);
+        return index >= 0 ? &values[(u32)index] : nullptr;
+    }
+
+    [[nodiscard]] const V* Get(const K& key) const
+    {
+        const i32 index = Find(key);
+        return index >= 0 ? &values[(u32)index] : nullptr;
+    }
+
+    [[nodiscard]] bool Contains(const K& key) const { return Find(key) >= 0; }
+
+    // Index of the first key not less than key
+    [[nodiscard]] u32 LowerBound(const K& key) const
+    {
+        return AE::lower_bound(KeysView(), key, LessT());
+    }
+
+    // Index of the first key greater than key
+    [[nodiscard]] u32 UpperBound(const K& key) const
+    {
+        return AE::upper_bound(KeysView(), key, LessT());
+    }
+
+    /*
+     * Replaces the content with already sorted, unique keys.
+     */
+    void BulkLoad(View<const K> sorted_keys, View<const V> sorted_values)
+    {
+        assert(sorted_keys.NumElements == sorted_values.NumElements);
+
+        Clear();
+        if (sorted_keys.NumElements == 0u)
+        {
+            return;
+        }
+
+        keys.Append(sorted_keys);
+        values.Append(sorted_values);
+
+#if !defined(NDEBUG)
+        for (u32 i = 1; i < Size(); i++)
+        {
+            assert(LessT()(keys[i - 1u], keys[i]));
+        }
+#endif
+    }
+
+    // ---------------- Ordered access ----------------
+
+    View<const K> KeysView() const
+    {
+        View<const K> Result = {.Data = keys.Data, .NumElements = Size()};
+        return Result;
+    }
+
+    View<V> ValuesView()
+    {
+        View<V> Result = {.Data = values.Data, .NumElements = Size()};
+        return Result;
+    }
+
+    struct RangeResult
+    {
+        View<const K> keys;
+        View<V>       values;
+    };
+
+    /*
+     * All entries with lo <= key < hi, as views into the map.
+     */
+    RangeResult Range(const K& lo, const K& hi)
+    {
+        const u32 first = LowerBound(lo);
+        const u32 last  = std::max(first, LowerBound(hi));
+
+        RangeResult Result = {
+            .keys   = {.Data = keys.Data + first, .NumElements = last - first},
+            .values = {.Data = values.Data + first, .NumElements = last - first},
+        };
+        return Result;
+    }
+
+  private:
+    static inline bool is_equal(const K& a, const K& b)
+    {
+        LessT less;
+        return !less(a, b) && !less(b, a);
+    }
+
+    template <typename T>
+    static void insert_at(Array<T>& array, u32 index, const T& elem)
+    {
+        const u32 num_tail = array.NumElements - index;
+        array.add_no_init(1u);
+        memmove(&array.Data[index + 1u], &array.Data[index],
+                num_tail * sizeof(T));
+        array.Data[index] = elem;
+    }
+
+    template <typename T>
+    static void remove_at(Array<T>& array, u32 index)
+    {
+        const u32 num_tail = array.NumElements - index - 1u;
+        memmove(&array.Data[index], &array.Data[index + 1u],
+                num_tail * sizeof(T));
+        array.NumElements--;
+    }
+};
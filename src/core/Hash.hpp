@@ -0,0 +1,495 @@
+#pragma once
+
+#include "Allocators.hpp"
+#include "BitList.hpp"
+#include "Intrinsics.hpp"
+#include "core.hpp"
+
+#include <cstring>
+#include <immintrin.h>
+#include <type_traits>
+
+/*
+ * Non cryptographic 64 bit hashing.
+ *
+ *  hash_bytes(data, size, seed)  one shot hash of a buffer
+ *  hash_mix(x)                   integer mixer, for ids/handles/pointers
+ *  hash_combine(a, b)            merges two hashes
+ *  Hasher                        streaming version of hash_bytes
+ *  Hash<T> / hash_value(v)       customization point for engine types
+ *
+ * Inputs up to HashLongThreshold bytes take a wyhash style path (a few 64x64->128
+ * multiplies, no loop for <= 16 bytes). Longer inputs are split in 64 byte
+ * stripes accumulated into 8 independent lanes, xxh3 style, which the AVX2
+ * path processes 4 lanes per instruction (2 with SSE2), picked at runtime
+ * from cpu_features(). Results are the same on every path, but aren't
+ * compatible with the reference wyhash/xxh3.
+ *
+ * Hash<T> specializations live next to their types (PoolHandle in Pool.hpp,
+ * StringView and Name in String.hpp).
+ */
+namespace Detail
+{
+
+inline u64 hash_read64(const u8* p)
+{
+    u64 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline u64 hash_read32(const u8* p)
+{
+    u32 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// 64x64 -> 128 multiply, folded back to 64 bits
+inline u64 mum_fold(u64 a, u64 b)
+{
+    const unsigned __int128 r = (unsigned __int128)a * b;
+    return (u64)r ^ (u64)(r >> 64);
+}
+
+constexpr u64 HashSecret[4] = {0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull,
+                               0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull};
+
+constexpr u32 HashLongThreshold = 256u;
+constexpr u32 HashStripeBytes   = 64u;
+constexpr u32 HashLanes         = HashStripeBytes / sizeof(u64);
+constexpr u32 HashBlockStripes  = 16u;
+constexpr u32 HashBlockBytes    = HashStripeBytes * HashBlockStripes;
+constexpr u32 HashKeyWords      = HashBlockStripes + HashLanes;
+constexpr u32 HashLastStripeKey = 7u;
+constexpr u64 HashPrime32       = 0x9e3779b1ull;
+
+consteval auto make_hash_keys()
+{
+    // splitmix64 sequence
+    struct
+    {
+        u64 words[HashKeyWords];
+    } keys = {};
+
+    u64 state = 0x243f6a8885a308d3ull;
+    for (u32 i = 0; i < HashKeyWords; i++)
+    {
+        state += 0x9e3779b97f4a7c15ull;
+        u64 z = state;
+        z     = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z     = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        keys.words[i] = z ^ (z >> 31);
+    }
+    return keys;
+}
+
+alignas(64) constexpr auto HashKeys = make_hash_keys();
+
+/*
+ * Adds num_stripes stripes to the accumulators, stripe s is keyed with
+ * HashKeys.words[key_offset + s ...].
+ */
+TARGET_AVX2 inline void hash_accumulate_avx2(u64* acc, const u8* data,
+                                             u32 num_stripes, u32 key_offset)
+{
+    __m256i acc_regs[2] = {_mm256_load_si256((const __m256i*)&acc[0]),
+                           _mm256_load_si256((const __m256i*)&acc[4])};
+
+    for (u32 s = 0; s < num_stripes; s++)
+    {
+        const u8*  stripe = data + s * HashStripeBytes;
+        const u64* key    = &HashKeys.words[key_offset + s];
+
+        for (u32 half = 0; half < 2u; half++)
+        {
+            const __m256i d = _mm256_loadu_si256((const __m256i*)stripe + half);
+            const __m256i k = _mm256_loadu_si256((const __m256i*)key + half);
+
+            const __m256i dk      = _mm256_xor_si256(d, k);
+            const __m256i product = _mm256_mul_epu32(dk, _mm256_srli_epi64(dk, 32));
+            // acc[i ^ 1] += data[i]
+            const __m256i swapped =
+                _mm256_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2));
+
+            acc_regs[half] = _mm256_add_epi64(
+                acc_regs[half], _mm256_add_epi64(product, swapped));
+        }
+    }
+
+    _mm256_store_si256((__m256i*)&acc[0], acc_regs[0]);
+    _mm256_store_si256((__m256i*)&acc[4], acc_regs[1]);
+}
+
+inline void hash_accumulate_generic(u64* acc, const u8* data, u32 num_stripes,
+                                    u32 key_offset)
+{
+#if defined(__SSE2__)
+    __m128i acc_regs[4];
+    for (u32 quarter = 0; quarter < 4u; quarter++)
+    {
+        acc_regs[quarter] = _mm_load_si128((const __m128i*)&acc[quarter * 2u]);
+    }
+
+    for (u32 s = 0; s < num_stripes; s++)
+    {
+        const u8*  stripe = data + s * HashStripeBytes;
+        const u64* key    = &HashKeys.words[key_offset + s];
+
+        for (u32 quarter = 0; quarter < 4u; quarter++)
+        {
+            const __m128i d = _mm_loadu_si128((const __m128i*)stripe + quarter);
+            const __m128i k = _mm_loadu_si128((const __m128i*)key + quarter);
+
+            const __m128i dk      = _mm_xor_si128(d, k);
+            const __m128i product = _mm_mul_epu32(dk, _mm_srli_epi64(dk, 32));
+            const __m128i swapped = _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2));
+
+            acc_regs[quarter] = _mm_add_epi64(acc_regs[quarter],
+                                              _mm_add_epi64(product, swapped));
+        }
+    }
+
+    for (u32 quarter = 0; quarter < 4u; quarter++)
+    {
+        _mm_store_si128((__m128i*)&acc[quarter * 2u], acc_regs[quarter]);
+    }
+#else
+    for (u32 s = 0; s < num_stripes; s++)
+    {
+        const u8*  stripe = data + s * HashStripeBytes;
+        const u64* key    = &HashKeys.words[key_offset + s];
+
+        for (u32 lane = 0; lane < HashLanes; lane++)
+        {
+            const u64 d  = hash_read64(stripe + lane * sizeof(u64));
+            const u64 dk = d ^ key[lane];
+
+            acc[lane ^ 1u] += d;
+            acc[lane] += (dk & 0xffffffffull) * (dk >> 32);
+        }
+    }
+#endif
+}
+
+inline void hash_accumulate(u64* acc, const u8* data, u32 num_stripes,
+                            u32 key_offset)
+{
+    if (Intrinsics::cpu_features().avx2)
+    {
+        hash_accumulate_avx2(acc, data, num_stripes, key_offset);
+    }
+    else
+    {
+        hash_accumulate_generic(acc, data, num_stripes, key_offset);
+    }
+}
+
+TARGET_AVX2 inline void hash_scramble_avx2(u64* acc)
+{
+    const u64*    key   = &HashKeys.words[HashBlockStripes];
+    const __m256i prime = _mm256_set1_epi32((i32)HashPrime32);
+
+    for (u32 half = 0; half < 2u; half++)
+    {
+        __m256i a = _mm256_load_si256((const __m256i*)&acc[half * 4u]);
+        a = _mm256_xor_si256(a, _mm256_srli_epi64(a, 47));
+        a = _mm256_xor_si256(a, _mm256_loadu_si256((const __m256i*)key + half));
+
+        // 64 bit multiply by a 32 bit prime out of two 32x32 multiplies
+        const __m256i lo = _mm256_mul_epu32(a, prime);
+        const __m256i hi = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), prime);
+        a = _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32));
+
+        _mm256_store_si256((__m256i*)&acc[half * 4u], a);
+    }
+}
+
+inline void hash_scramble(u64* acc)
+{
+    if (Intrinsics::cpu_features().avx2)
+    {
+        hash_scramble_avx2(acc);
+        return;
+    }
+
+    const u64* key = &HashKeys.words[HashBlockStripes];
+    for (u32 lane = 0; lane < HashLanes; lane++)
+    {
+        u64 a = acc[lane];
+        a ^= a >> 47;
+        a ^= key[lane];
+        acc[lane] = a * HashPrime32;
+    }
+}
+
+inline void hash_init_acc(u64* acc, u64 seed)
+{
+    for (u32 lane = 0; lane < HashLanes; lane++)
+    {
+        acc[lane] = HashKeys.words[lane] ^ seed;
+    }
+}
+
+inline void hash_accumulate_block(u64* acc, const u8* block)
+{
+    hash_accumulate(acc, block, HashBlockStripes, 0u);
+    hash_scramble(acc);
+}
+
+/*
+ * Last (partial) block: tail holds 1..HashBlockBytes bytes, last_stripe the
+ * final 64 bytes of the input (overlapping the previous stripe when the tail
+ * isn't a whole number of stripes).
+ */
+inline u64 hash_finish_long(u64* acc, const u8* tail, u32 tail_size,
+                            const u8* last_stripe, u64 total_size)
+{
+    hash_accumulate(acc, tail, (tail_size - 1u) / HashStripeBytes, 0u);
+    hash_accumulate(acc, last_stripe, 1u, HashLastStripeKey);
+
+    u64 result = total_size * 0x9e3779b185ebca87ull;
+    for (u32 i = 0; i < HashLanes; i += 2u)
+    {
+        result += mum_fold(acc[i] ^ HashKeys.words[i + 3u],
+                           acc[i + 1u] ^ HashKeys.words[i + 4u]);
+    }
+    return mum_fold(result ^ HashSecret[2], HashSecret[3] ^ total_size);
+}
+
+inline u64 hash_long(const u8* data, u64 size, u64 seed)
+{
+    alignas(32) u64 acc[HashLanes];
+    hash_init_acc(acc, seed);
+
+    const u64 num_blocks = (size - 1u) / HashBlockBytes;
+    for (u64 b = 0; b < num_blocks; b++)
+    {
+        hash_accumulate_block(acc, data + b * HashBlockBytes);
+    }
+
+    const u64 tail_offset = num_blocks * HashBlockBytes;
+    return hash_finish_long(acc, data + tail_offset, (u32)(size - tail_offset),
+                            data + size - HashStripeBytes, size);
+}
+
+} // namespace Detail
+
+inline u64 hash_mix(u64 x)
+{
+    return Detail::mum_fold(x ^ Detail::HashSecret[0], Detail::HashSecret[1]);
+}
+
+inline u64 hash_combine(u64 a, u64 b)
+{
+    return Detail::mum_fold(a ^ Detail::HashSecret[0], b ^ Detail::HashSecret[1]);
+}
+
+inline u64 hash_bytes(const void* data, u64 size, u64 seed = 0u)
+{
+    using namespace Detail;
+
+    const u8* p = static_cast<const u8*>(data);
+
+    if (size > HashLongThreshold)
+    {
+        return hash_long(p, size, seed);
+    }
+
+    seed ^= mum_fold(seed ^ HashSecret[0], HashSecret[1]);
+
+    u64 a = 0u;
+    u64 b = 0u;
+    if (size <= 16u)
+    {
+        if (size >= 4u)
+        {
+            // two (possibly overlapping) pairs of u32 cover 4..16 bytes
+            const u64 mid = (size >> 3) << 2;
+            a = (hash_read32(p) << 32) | hash_read32(p + mid);
+            b = (hash_read32(p + size - 4u) << 32) |
+                hash_read32(p + size - 4u - mid);
+        }
+        else if (size > 0u)
+        {
+            a = ((u64)p[0] << 16) | ((u64)p[size >> 1] << 8) | p[size - 1u];
+        }
+    }
+    else
+    {
+        u64 left = size;
+        if (left > 48u)
+        {
+            u64 see1 = seed;
+            u64 see2 = seed;
+            do
+            {
+                seed = mum_fold(hash_read64(p) ^ HashSecret[1],
+                                hash_read64(p + 8) ^ seed);
+                see1 = mum_fold(hash_read64(p + 16) ^ HashSecret[2],
+                                hash_read64(p + 24) ^ see1);
+                see2 = mum_fold(hash_read64(p + 32) ^ HashSecret[3],
+                                hash_read64(p + 40) ^ see2);
+                p += 48;
+                left -= 48u;
+            } while (left > 48u);
+            seed ^= see1 ^ see2;
+        }
+        while (left > 16u)
+        {
+            seed = mum_fold(hash_read64(p) ^ HashSecret[1],
+                            hash_read64(p + 8) ^ seed);
+            p += 16;
+            left -= 16u;
+        }
+        a = hash_read64(p + left - 16u);
+        b = hash_read64(p + left - 8u);
+    }
+
+    a ^= HashSecret[1];
+    b ^= seed;
+    const unsigned __int128 r = (unsigned __int128)a * b;
+    a                         = (u64)r;
+    b                         = (u64)(r >> 64);
+
+    return mum_fold(a ^ HashSecret[0] ^ size, b ^ HashSecret[1]);
+}
+
+/*
+ * Hasher
+ *
+ * Streaming hash_bytes: update() can be fed a buffer in pieces of any size,
+ * finish() returns the same value hash_bytes would for the concatenation.
+ * Whole blocks are hashed straight from the input, only the remainder is
+ * buffered.
+ */
+class Hasher final
+{
+  public:
+    explicit Hasher(u64 seed = 0u) : seed(seed)
+    {
+        Detail::hash_init_acc(acc, seed);
+    }
+
+    void update(const void* data, u64 size)
+    {
+        using namespace Detail;
+
+        const u8* p = static_cast<const u8*>(data);
+        total_size += size;
+
+        while (size > 0u)
+        {
+            // a block is only hashed once more input follows it, the last
+            // block of the input goes through hash_finish_long
+            if (buffered == HashBlockBytes)
+            {
+                hash_accumulate_block(acc, buffer);
+                memcpy(last_stripe, buffer + HashBlockBytes - HashStripeBytes,
+                       HashStripeBytes);
+                buffered = 0u;
+            }
+
+            if (buffered == 0u && size > HashBlockBytes)
+            {
+                while (size > HashBlockBytes)
+                {
+                    hash_accumulate_block(acc, p);
+                    p += HashBlockBytes;
+                    size -= HashBlockBytes;
+                }
+                memcpy(last_stripe, p - HashStripeBytes, HashStripeBytes);
+            }
+
+            const u32 num_copied =
+                (u32)std::min<u64>(size, HashBlockBytes - buffered);
+            memcpy(buffer + buffered, p, num_copied);
+            buffered += num_copied;
+            p += num_copied;
+            size -= num_copied;
+        }
+    }
+
+    u64 finish() const
+    {
+        using namespace Detail;
+
+        if (total_size <= HashLongThreshold)
+        {
+            return hash_bytes(buffer, total_size, seed);
+        }
+
+        alignas(32) u64 acc_copy[HashLanes];
+        memcpy(acc_copy, acc, sizeof(acc));
+
+        // stitch the final stripe together when the tail is shorter than one
+        u8        stitched[HashStripeBytes];
+        const u8* final_stripe = buffer + buffered - HashStripeBytes;
+        if (buffered < HashStripeBytes)
+        {
+            const u32 from_last = HashStripeBytes - buffered;
+            memcpy(stitched, last_stripe + buffered, from_last);
+            memcpy(stitched + from_last, buffer, buffered);
+            final_stripe = stitched;
+        }
+
+        return hash_finish_long(acc_copy, buffer, buffered, final_stripe,
+                                total_size);
+    }
+
+  private:
+    alignas(32) u64 acc[Detail::HashLanes];
+    alignas(32) u8 buffer[Detail::HashBlockBytes];
+    u8  last_stripe[Detail::HashStripeBytes];
+    u32 buffered   = 0u;
+    u64 total_size = 0u;
+    u64 seed;
+};
+
+// ---------------- Hash<T> customization point ----------------
+
+template <typename T>
+struct Hash;
+
+template <typename T>
+    requires std::is_integral_v<T> || std::is_enum_v<T> || std::is_pointer_v<T>
+struct Hash<T>
+{
+    inline u64 operator()(T value) const
+    {
+        if constexpr (std::is_pointer_v<T>)
+        {
+            return hash_mix((u64)(uintptr_t)value);
+        }
+        else
+        {
+            return hash_mix((u64)value);
+        }
+    }
+};
+
+template <>
+struct Hash<MemoryHandle>
+{
+    inline u64 operator()(const MemoryHandle& handle) const
+    {
+        return hash_combine(hash_combine((u64)(uintptr_t)handle.owningAllocator,
+                                         handle.offset),
+                            handle.size);
+    }
+};
+
+template <u32 N, typename WordType>
+struct Hash<BitList<N, WordType>>
+{
+    inline u64 operator()(const BitList<N, WordType>& bits) const
+    {
+        return hash_bytes(bits.data, sizeof(bits.data));
+    }
+};
+
+template <typename T>
+inline u64 hash_value(const T& value)
+{
+    return Hash<T>{}(value);
+}
@@ -2,8 +2,25 @@
 
 #include "core.hpp"
 
+#if defined(__clang__) || defined(__GNUC__)
+#include <cpuid.h>
+#endif
+
 // #include <immintrin.h>
 
+// Per function ISA targets, for kernels picked at runtime from cpu_features()
+#if defined(__clang__) || defined(__GNUC__)
+#define TARGET_POPCNT        __attribute__((target("popcnt")))
+#define TARGET_AVX2          __attribute__((target("avx2,popcnt")))
+#define TARGET_AVX512        __attribute__((target("avx512f,avx512bw,avx2,popcnt")))
+#define TARGET_AVX512_POPCNT __attribute__((target("avx512f,avx512bw,avx512vpopcntdq,avx2,popcnt")))
+#else
+#define TARGET_POPCNT
+#define TARGET_AVX2
+#define TARGET_AVX512
+#define TARGET_AVX512_POPCNT
+#endif
+
 namespace Intrinsics
 {
 
@@ -57,4 +74,55 @@ constexpr inline i32 find_msb(u32 value)
 // #endif
 // }
 
+struct CpuFeatures
+{
+    bool popcnt        = false;
+    bool avx2          = false;
+    bool avx512        = false; // F + BW
+    bool avx512_popcnt = false; // VPOPCNTDQ
+};
+
+inline CpuFeatures detect_cpu_features()
+{
+    CpuFeatures features;
+#if defined(__clang__) || defined(__GNUC__)
+    u32 eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    {
+        return features;
+    }
+
+    features.popcnt = (ecx >> 23) & 1u;
+
+    // the OS has to save the wide registers on context switches as well
+    const bool osxsave = (ecx >> 27) & 1u;
+    if (!osxsave)
+    {
+        return features;
+    }
+
+    u32 xcr0_lo, xcr0_hi;
+    __asm__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+
+    const bool os_avx    = (xcr0_lo & 0x06u) == 0x06u;
+    const bool os_avx512 = (xcr0_lo & 0xe6u) == 0xe6u;
+
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+    {
+        return features;
+    }
+
+    features.avx2          = os_avx && ((ebx >> 5) & 1u);
+    features.avx512        = os_avx512 && ((ebx >> 16) & 1u) && ((ebx >> 30) & 1u);
+    features.avx512_popcnt = features.avx512 && ((ecx >> 14) & 1u);
+#endif
+    return features;
+}
+
+inline const CpuFeatures& cpu_features()
+{
+    static const CpuFeatures features = detect_cpu_features();
+    return features;
+}
+
 } // namespace Intrinsics
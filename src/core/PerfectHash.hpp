@@ -0,0 +1,217 @@
+#pragma once
+
+#include "core.hpp"
+
+#include <string_view>
+#include <type_traits>
+
+/*
+ * Compile time perfect hashing for static key sets (extension names, binding
+ * names, ...).
+ *
+ *  static constexpr auto required_ext = make_perfect_hash_set<std::string_view>(
+ *      {VK_KHR_SWAPCHAIN_EXTENSION_NAME, VK_EXT_MESH_SHADER_EXTENSION_NAME});
+ *
+ *  i32 index = required_ext.find(props.extensionName); // -1 if not in the set
+ *
+ * The table is built by hash and displace (CHD): keys are grouped in buckets
+ * by their hash and every bucket gets a seed that sends all its keys to free
+ * slots. A lookup is one key hash, one integer mix with the bucket's seed and
+ * a single key compare.
+ */
+namespace Detail
+{
+
+// FNV-1a, usable in constant evaluation
+constexpr inline u64 static_hash(std::string_view key)
+{
+    u64 hash = 0xcbf29ce484222325ull;
+    for (const char c : key)
+    {
+        hash ^= (u8)c;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+template <typename KeyT>
+    requires std::is_integral_v<KeyT> || std::is_enum_v<KeyT>
+constexpr inline u64 static_hash(KeyT key)
+{
+    u64 hash = (u64)key;
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+constexpr inline u64 displace(u64 hash, u32 seed)
+{
+    u64 x = hash ^ ((u64)seed * 0x9e3779b97f4a7c15ull);
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 29;
+    return x;
+}
+
+// Not a constant expression: reaching it during consteval is a compile error
+inline void perfect_hash_build_failed(const char*) {}
+
+} // namespace Detail
+
+template <typename KeyT, u32 N>
+    requires(N > 0u)
+struct PerfectHashSet
+{
+    static constexpr u32 NumSlots   = round_up_pow2(N + N / 4u + 1u);
+    static constexpr u32 SlotMask   = NumSlots - 1u;
+    static constexpr u32 NumBuckets = (N + 1u) / 2u;
+
+    u32  seeds[NumBuckets]     = {};
+    KeyT keys[NumSlots]        = {};
+    i32  key_indices[NumSlots] = {};
+
+    static constexpr inline u32 bucket_index(u64 hash)
+    {
+        return (u32)(((hash >> 32) * NumBuckets) >> 32);
+    }
+
+    inline constexpr u32 slot_index(u64 hash) const
+    {
+        return (u32)Detail::displace(hash, seeds[bucket_index(hash)]) &
+               SlotMask;
+    }
+
+    /*
+     * Index of key in the list the set was built from, -1 if it's not part of
+     * the set.
+     */
+    [[nodiscard]] constexpr i32 find(const KeyT& key) const
+    {
+        const u32 slot = slot_index(Detail::static_hash(key));
+        return key_indices[slot] >= 0 && keys[slot] == key ? key_indices[slot]
+                                                          : -1;
+    }
+
+    [[nodiscard]] constexpr bool contains(const KeyT& key) const
+    {
+        return find(key) >= 0;
+    }
+
+    constexpr u32 Size() const { return N; }
+};
+
+template <typename KeyT, u32 N>
+consteval PerfectHashSet<KeyT, N> make_perfect_hash_set(const KeyT (&keys)[N])
+{
+    using SetT = PerfectHashSet<KeyT, N>;
+
+    SetT result;
+    for (u32 slot = 0; slot < SetT::NumSlots; slot++)
+    {
+        result.key_indices[slot] = -1;
+    }
+
+    u64 hashes[N];
+    for (u32 i = 0; i < N; i++)
+    {
+        hashes[i] = Detail::static_hash(keys[i]);
+        for (u32 j = 0; j < i; j++)
+        {
+            if (keys[i] == keys[j])
+            {
+                Detail::perfect_hash_build_failed("duplicate key");
+            }
+        }
+    }
+
+    // Place the largest buckets first, while most slots are still free
+    u32 bucket_sizes[SetT::NumBuckets] = {};
+    u32 bucket_order[SetT::NumBuckets] = {};
+    for (u32 i = 0; i < N; i++)
+    {
+        bucket_sizes[SetT::bucket_index(hashes[i])]++;
+    }
+    for (u32 b = 0; b < SetT::NumBuckets; b++)
+    {
+        bucket_order[b] = b;
+    }
+    for (u32 b = 1; b < SetT::NumBuckets; b++)
+    {
+        for (u32 j = b; j > 0 && bucket_sizes[bucket_order[j]] >
+                                     bucket_sizes[bucket_order[j - 1u]];
+             j--)
+        {
+            const u32 tmp        = bucket_order[j];
+            bucket_order[j]      = bucket_order[j - 1u];
+            bucket_order[j - 1u] = tmp;
+        }
+    }
+
+    bool slot_taken[SetT::NumSlots] = {};
+    for (u32 b = 0; b < SetT::NumBuckets; b++)
+    {
+        const u32 bucket = bucket_order[b];
+        if (bucket_sizes[bucket] == 0u)
+        {
+            break;
+        }
+
+        constexpr u32 MaxSeed = 1u << 20;
+
+        u32 seed = 0u;
+        for (; seed < MaxSeed; seed++)
+        {
+            // slots claimed by this bucket for the current seed
+            u32  claimed[N];
+            u32  num_claimed = 0u;
+            bool fits        = true;
+
+            for (u32 i = 0; i < N && fits; i++)
+            {
+                if (SetT::bucket_index(hashes[i]) != bucket)
+                {
+                    continue;
+                }
+
+                const u32 slot =
+                    (u32)Detail::displace(hashes[i], seed) & SetT::SlotMask;
+
+                fits = !slot_taken[slot];
+                for (u32 c = 0; c < num_claimed && fits; c++)
+                {
+                    fits = claimed[c] != slot;
+                }
+                claimed[num_claimed++] = slot;
+            }
+
+            if (fits)
+            {
+                break;
+            }
+        }
+
+        if (seed == MaxSeed)
+        {
+            Detail::perfect_hash_build_failed("no seed found for bucket");
+        }
+
+        result.seeds[bucket] = seed;
+        for (u32 i = 0; i < N; i++)
+        {
+            if (SetT::bucket_index(hashes[i]) == bucket)
+            {
+                const u32 slot =
+                    (u32)Detail::displace(hashes[i], seed) & SetT::SlotMask;
+
+                slot_taken[slot]         = true;
+                result.keys[slot]        = keys[i];
+                result.key_indices[slot] = (i32)i;
+            }
+        }
+    }
+
+    return result;
+}
@@ -4,6 +4,11 @@
 #include "../core/Intrinsics.hpp"
 #include "../core/Containers.hpp"
 #include "../core/BitList.hpp"
+#include "../core/Hash.hpp"
+#include "../core/utils/Soa.hpp"
+
+#include <immintrin.h>
+#include <type_traits>
 
 template <typename HandleT, u32 INDEX_BITS,
           u32 GEN_BITS = sizeof(HandleT) * 8u - INDEX_BITS>
@@ -28,38 +33,225 @@ struct PoolHandle
     HandleT gen   : GEN_BITS + PAD_BITS;
 };
 
+template <typename HandleT, u32 INDEX_BITS, u32 GEN_BITS>
+struct Hash<PoolHandle<HandleT, INDEX_BITS, GEN_BITS>>
+{
+    inline u64 operator()(const PoolHandle<HandleT, INDEX_BITS, GEN_BITS>& handle) const
+    {
+        return hash_mix(((u64)handle.gen << 32) | (u64)handle.index);
+    }
+};
+
+/*
+ * Removal that waits for a frame (or timeline value) to complete, see
+ * Pool::remove_element_deferred.
+ */
+struct PendingRemoval
+{
+    u32 index;
+    u64 frame;
+};
+
+namespace Detail
+{
+
+/*
+ * Batched handle validation for 32 bit handles with the index in the low
+ * index_bits and the generation above (the bitfield layout of PoolHandle).
+ * out_indices gets the slot of every valid handle and 0, the null slot, for
+ * invalid ones. Bit i of out_valid is set for valid handles, out_valid is
+ * overwritten for whole words. The generations of the handles
+ * ResolvePrefetchAhead positions ahead are prefetched. Returns the number of
+ * valid handles.
+ */
+using ResolveKernel = u32 (*)(const u32* handles, u32 num_handles,
+                              const u32* generations, u32 num_slots,
+                              u32 index_bits, u32* out_indices, u64* out_valid);
+
+static constexpr u32 ResolvePrefetchAhead = 32u;
+
+inline u32 resolve_handles_scalar(const u32* handles, u32 num_handles,
+                                  const u32* generations, u32 num_slots,
+                                  u32 index_bits, u32* out_indices,
+                                  u64* out_valid)
+{
+    const u32 index_mask = (1u << index_bits) - 1u;
+
+    memset(out_valid, 0, ((num_handles + 63u) / 64u) * sizeof(u64));
+
+    u32 num_valid = 0u;
+    for (u32 i = 0; i < num_handles; i++)
+    {
+        if (i + ResolvePrefetchAhead < num_handles)
+        {
+            const u32 ahead = handles[i + ResolvePrefetchAhead] & index_mask;
+            if (ahead < num_slots)
+            {
+                __builtin_prefetch(&generations[ahead]);
+            }
+        }
+
+        const u32  index = handles[i] & index_mask;
+        const u32  gen   = handles[i] >> index_bits;
+        const bool valid =
+            index > 0u && index < num_slots && generations[index] == gen;
+
+        out_indices[i] = valid ? index : 0u;
+        out_valid[i / 64u] |= (u64)valid << (i % 64u);
+        num_valid += valid;
+    }
+    return num_valid;
+}
+
+/*
+ * 8 handles per iteration: split with an and/shift, range check, gather the
+ * generations of the in range ones and compare, movemask for the valid bits.
+ */
+TARGET_AVX2 inline u32 resolve_handles_avx2(const u32* handles, u32 num_handles,
+                                            const u32* generations,
+                                            u32 num_slots, u32 index_bits,
+                                            u32* out_indices, u64* out_valid)
+{
+    constexpr u32 Lanes = 8u;
+
+    const __m256i index_mask = _mm256_set1_epi32((i32)((1u << index_bits) - 1u));
+    const __m256i slots      = _mm256_set1_epi32((i32)num_slots);
+    const __m256i zero       = _mm256_setzero_si256();
+    const __m128i gen_shift  = _mm_cvtsi32_si128((i32)index_bits);
+
+    memset(out_valid, 0, ((num_handles + 63u) / 64u) * sizeof(u64));
+
+    u32 num_valid = 0u;
+    u32 i         = 0u;
+
+    const u32 num_simd = round_down(num_handles, Lanes);
+    for (; i < num_simd; i += Lanes)
+    {
+        const __m256i packed = _mm256_loadu_si256((const __m256i*)&handles[i]);
+        const __m256i index  = _mm256_and_si256(packed, index_mask);
+        const __m256i gen    = _mm256_srl_epi32(packed, gen_shift);
+
+        // indices are < 2^31, signed compares are fine
+        const __m256i in_range =
+            _mm256_and_si256(_mm256_cmpgt_epi32(index, zero),
+                             _mm256_cmpgt_epi32(slots, index));
+
+        const __m256i slot_gen = _mm256_mask_i32gather_epi32(
+            zero, (const int*)generations, index, in_range, 4);
+        const __m256i valid =
+            _mm256_and_si256(in_range, _mm256_cmpeq_epi32(slot_gen, gen));
+
+        _mm256_storeu_si256((__m256i*)&out_indices[i],
+                            _mm256_and_si256(index, valid));
+
+        const u32 bits =
+            (u32)_mm256_movemask_ps(_mm256_castsi256_ps(valid));
+        out_valid[i / 64u] |= (u64)bits << (i % 64u);
+        num_valid += (u32)__builtin_popcount(bits);
+
+        const u32 prefetch_end =
+            std::min(i + Lanes + ResolvePrefetchAhead, num_handles);
+        for (u32 ahead = i + ResolvePrefetchAhead; ahead < prefetch_end; ahead++)
+        {
+            const u32 slot = handles[ahead] & ((1u << index_bits) - 1u);
+            if (slot < num_slots)
+            {
+                __builtin_prefetch(&generations[slot]);
+            }
+        }
+    }
+
+    if (i < num_handles)
+    {
+        // the tail's mask word is shared with the SIMD part, resolve it into
+        // a local word and merge
+        u64 tail_valid[2] = {};
+        num_valid += resolve_handles_scalar(
+            &handles[i], num_handles - i, generations, num_slots, index_bits,
+            &out_indices[i], tail_valid);
+
+        // i is a multiple of 8, the tail is shorter than 8 and fits in the
+        // current word
+        out_valid[i / 64u] |= tail_valid[0] << (i % 64u);
+    }
+    return num_valid;
+}
+
+inline ResolveKernel resolve_kernel()
+{
+    static const ResolveKernel kernel = Intrinsics::cpu_features().avx2
+                                            ? &resolve_handles_avx2
+                                            : &resolve_handles_scalar;
+    return kernel;
+}
+
+} // namespace Detail
+
+enum class EPoolStorage : u8
+{
+    AOS, // objects stored whole, Array<T>
+    SOA  // every field of SoaSchema<T> in its own array, SOA<T>
+};
+
 /*
  * Pool
  *
  * PoolHandleT should be a child or instance of PoolHandle<...>
+ *
+ * With EPoolStorage::SOA the fields share the slot index and generation
+ * scheme (handles are the same), passes that only touch a field or two run
+ * over its field_view() instead of loading whole objects. Views cover all
+ * slots, including free ones.
  */
-template <typename T, typename PoolHandleT>
+template <typename T, typename PoolHandleT,
+          EPoolStorage Storage = EPoolStorage::AOS>
 class Pool
 {
+  public:
+    using Objects =
+        std::conditional_t<Storage == EPoolStorage::SOA, SOA<T>, Array<T>>;
+
   public:
     [[nodiscard]] explicit Pool(IAllocator& allocator, u32 start_size)
-        : generations(allocator, start_size), freelist(allocator, start_size),
-          objects(allocator, start_size)
+        : generations(allocator, start_size),
+          freelist(allocator, num_freelist_chunks(generations._NumAllocated)),
+          objects(allocator, start_size),
+          dirty(allocator, num_freelist_chunks(generations._NumAllocated)),
+          pending_removals(allocator)
     {
         generations.NumElements = generations._NumAllocated;
         objects.NumElements     = objects._NumAllocated;
+
+        // index 0 is never handed out, it's the null handle
+        freelist.set_bit(0u);
     }
 
     [[nodiscard]] PoolHandleT add_element(T&& elem)
     {
-        i32 free_index = freelist.find_first(false); // find open spot
-        if (free_index < 0)
+        // find open spot, the freelist summaries make this O(1)
+        i32 free_index = freelist.find_first(false);
+
+        // the freelist is rounded up to whole chunks, it can have free bits
+        // past the last slot
+        if (free_index < 0 || (u32)free_index >= generations.NumElements)
         {
             const u32 old_size = generations.NumElements;
             const u32 new_size = old_size * 2u;
             freelist.resize(new_size);
-            generations.Resize(new_size);
-            objects.Resize(new_size);
+            dirty.resize(new_size);
+            generations.add_no_init(new_size - old_size);
+            objects.add_no_init(new_size - old_size);
+
+            for (u32 i = old_size; i < new_size; i++)
+            {
+                generations[i] = 0u;
+            }
 
             free_index = old_size;
         }
 
         freelist.set_bit(free_index);
+        dirty.set_bit(free_index);
         objects[free_index] = std::move(elem);
 
         const u32 index = (u32)free_index & 0xFFFFFF;
@@ -77,11 +269,179 @@ class Pool
         const u32 index = handle.index;
 
         freelist.unset_bit(index);
+        dirty.set_bit(index);
         generations[index] = (generations[index] + 1) % PoolHandleT::MAX_GEN;
     }
 
+    /*
+     * Removal of an element the GPU may still read: the handle is invalid
+     * right away, but the slot isn't reused before release_completed() is
+     * called with a completed frame >= frame. Frames must not decrease
+     * between calls.
+     */
+    void remove_element_deferred(const PoolHandleT& handle, u64 frame)
+    {
+        if (!is_handle_valid(handle))
+        {
+            return;
+        }
+
+        assert(pending_removals.NumElements == 0u ||
+               pending_removals[pending_removals.NumElements - 1u].frame <= frame);
+
+        // marked dirty by release_completed, once the slot is actually free
+        const u32 index    = handle.index;
+        generations[index] = (generations[index] + 1) % PoolHandleT::MAX_GEN;
+
+        pending_removals.add_no_init(1u);
+        pending_removals[pending_removals.NumElements - 1u] = {index, frame};
+    }
+
+    /*
+     * Frees the slots of all deferred removals up to completed_frame, returns
+     * how many were freed.
+     */
+    u32 release_completed(u64 completed_frame)
+    {
+        u32 num_released = 0u;
+        while (num_released < pending_removals.NumElements &&
+               pending_removals[num_released].frame <= completed_frame)
+        {
+            freelist.unset_bit(pending_removals[num_released].index);
+            dirty.set_bit(pending_removals[num_released].index);
+            num_released++;
+        }
+
+        const u32 num_left = pending_removals.NumElements - num_released;
+        if (num_released > 0u && num_left > 0u)
+        {
+            memmove(pending_removals.Data, &pending_removals.Data[num_released],
+                    num_left * sizeof(PendingRemoval));
+        }
+        pending_removals.NumElements = num_left;
+
+        return num_released;
+    }
+
+    /*
+     * Single field of an element, same in both storage modes:
+     *  pool.get_field<&Instance::transform>(handle) = transform;
+     */
+    template <auto Member>
+    inline auto& get_field(const PoolHandleT& handle)
+    {
+        assert(is_handle_valid(handle));
+        if constexpr (Storage == EPoolStorage::SOA)
+        {
+            return objects.template Field<Member>()[handle.index];
+        }
+        else
+        {
+            return objects[handle.index].*Member;
+        }
+    }
+
+    template <auto Member>
+        requires(Storage == EPoolStorage::SOA)
+    inline auto field_view()
+    {
+        return objects.template Field<Member>();
+    }
+
+    template <auto Member>
+        requires(Storage == EPoolStorage::SOA)
+    inline auto field_view() const
+    {
+        return objects.template Field<Member>();
+    }
+
+    /*
+     * Validates many handles at once. out_indices[i] is the slot of
+     * handles[i], 0 (the null slot) if it's invalid. Bit i of out_valid, one
+     * u64 per 64 handles, tells whether handles[i] is valid. Returns the
+     * number of valid handles.
+     *
+     * 32 bit handles are checked 8 at a time with AVX2 when available
+     * (generations gathered, validity from a movemask). Object rows aren't
+     * prefetched here: a whole list is resolved before it is used, by then
+     * prefetched rows are evicted again.
+     */
+    u32 resolve_batch(View<const PoolHandleT> handles, u32* out_indices,
+                      u64* out_valid) const
+    {
+        if (handles.NumElements == 0u)
+        {
+            return 0u;
+        }
+
+        if constexpr (sizeof(PoolHandleT) == sizeof(u32) && IndexBits < 31u)
+        {
+            // the kernels decode the bitfields by hand, index comes first
+            assert(packed_handle(handles.Data[0]) ==
+                   ((u32)handles.Data[0].index |
+                    ((u32)handles.Data[0].gen << IndexBits)));
+
+            return Detail::resolve_kernel()(
+                reinterpret_cast<const u32*>(handles.Data), handles.NumElements,
+                generations.Data, generations.NumElements, IndexBits,
+                out_indices, out_valid);
+        }
+        else
+        {
+            memset(out_valid, 0, ((handles.NumElements + 63u) / 64u) * sizeof(u64));
+
+            u32 num_valid = 0u;
+            for (u32 i = 0; i < handles.NumElements; i++)
+            {
+                const bool valid = is_handle_valid(handles.Data[i]);
+                out_indices[i]   = valid ? (u32)handles.Data[i].index : 0u;
+                out_valid[i / 64u] |= (u64)valid << (i % 64u);
+                num_valid += valid;
+            }
+            return num_valid;
+        }
+    }
+
+    /*
+     * Same as above with object pointers, nullptr for invalid handles.
+     */
+    u32 resolve_batch(View<const PoolHandleT> handles, T** out_objects,
+                      u64* out_valid)
+        requires(Storage == EPoolStorage::AOS)
+    {
+        constexpr u32 BatchSize = 256u;
+
+        u32 indices[BatchSize];
+        u32 num_valid = 0u;
+        for (u32 first = 0; first < handles.NumElements; first += BatchSize)
+        {
+            const u32 count = std::min(BatchSize, handles.NumElements - first);
+
+            View<const PoolHandleT> batch = {.Data        = &handles.Data[first],
+                                             .NumElements = count};
+            num_valid += resolve_batch(batch, indices, &out_valid[first / 64u]);
+
+            for (u32 i = 0; i < count; i++)
+            {
+                out_objects[first + i] =
+                    indices[i] != 0u ? &objects.Data[indices[i]] : nullptr;
+            }
+        }
+        return num_valid;
+    }
+
     const T& get_elemement(const PoolHandleT& handle) const;
-    T&       update_element(const PoolHandleT& handle, T&& new_elem);
+
+    void update_element(const PoolHandleT& handle, T&& new_elem)
+    {
+        if (!is_handle_valid(handle))
+        {
+            return;
+        }
+
+        objects[handle.index] = std::move(new_elem);
+        dirty.set_bit(handle.index);
+    }
 
     inline bool is_handle_valid(const PoolHandleT& handle) const
     {
@@ -90,13 +450,56 @@ class Pool
                handle.gen == generations[index];
     }
 
-    inline bool is_dirty() const { return dirty; }
+    // O(1) through the bitlist summaries
+    inline bool is_dirty() const { return dirty.find_first(true) >= 0; }
+
+    /*
+     * Calls func(u32 slot) for every slot added, updated or removed (deferred
+     * removals once they are released) since the last call, in increasing
+     * order, and clears the dirty bits.
+     */
+    template <typename FuncT>
+    void consume_dirty(FuncT&& func)
+    {
+        if (!is_dirty())
+        {
+            return;
+        }
+
+        bitlist_for_each_set(dirty, func);
+
+        for (u32 i = 0; i < dirty.num_chunks(); i++)
+        {
+            dirty.chunks[i] = DynamicBitlist<64u>::Chunk();
+        }
+        dirty.rebuild_summaries();
+    }
 
   public:
     Array<u32>          generations;
     DynamicBitlist<64u> freelist;
-    Array<T>            objects;
+    Objects             objects;
+    DynamicBitlist<64u> dirty; // per slot, see consume_dirty
+
+    Array<PendingRemoval> pending_removals; // in frame order
 
   private:
-    bool dirty = false;
+    static constexpr u32 IndexBits =
+        (u32)__builtin_popcountll((u64)PoolHandleT::MAX_INDEX);
+
+    static inline u32 packed_handle(const PoolHandleT& handle)
+    {
+        u32 packed;
+        memcpy(&packed, &handle, sizeof(u32));
+        return packed;
+    }
+
+    static inline u32 num_freelist_chunks(u32 num_slots)
+    {
+        using Freelist = DynamicBitlist<64u>;
+        return (num_slots + Freelist::BitsPerChunk - 1u) / Freelist::BitsPerChunk;
+    }
 };
+
+template <typename T, typename PoolHandleT>
+using SoaPool = Pool<T, PoolHandleT, EPoolStorage::SOA>;
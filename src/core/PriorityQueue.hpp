@@ -0,0 +1,383 @@
+#pragma once
+
+#include "Allocators.hpp"
+#include "Containers.hpp"
+#include "core.hpp"
+
+#include <functional>
+#include <type_traits>
+
+namespace Detail
+{
+
+/*
+ * Sift helpers shared by the heaps. on_move(elem, index) is called for every
+ * element that lands on a new index, the indexed heap uses it to keep its
+ * id -> position map up to date.
+ */
+template <u32 D, typename T, typename CompareT, typename OnMoveT>
+inline void heap_sift_up(T* data, u32 index, CompareT& compare,
+                         OnMoveT&& on_move)
+{
+    T elem = data[index];
+    while (index > 0u)
+    {
+        const u32 parent = (index - 1u) / D;
+        if (!compare(elem, data[parent]))
+        {
+            break;
+        }
+
+        data[index] = data[parent];
+        on_move(data[index], index);
+        index = parent;
+    }
+
+    data[index] = elem;
+    on_move(data[index], index);
+}
+
+template <u32 D, typename T, typename CompareT, typename OnMoveT>
+inline void heap_sift_down(T* data, u32 num_elements, u32 index,
+                           CompareT& compare, OnMoveT&& on_move)
+{
+    T elem = data[index];
+    while (true)
+    {
+        const u32 first_child = index * D + 1u;
+        if (first_child >= num_elements)
+        {
+            break;
+        }
+
+        // pick the best of the (up to) D children, they share a cache line
+        // for small T which is what makes a wide heap cheaper than a binary one
+        const u32 last_child = std::min(first_child + D, num_elements);
+        u32       best       = first_child;
+        for (u32 child = first_child + 1u; child < last_child; child++)
+        {
+            best = compare(data[child], data[best]) ? child : best;
+        }
+
+        if (!compare(data[best], elem))
+        {
+            break;
+        }
+
+        data[index] = data[best];
+        on_move(data[index], index);
+        index = best;
+    }
+
+    data[index] = elem;
+    on_move(data[index], index);
+}
+
+/*
+ * Pop variant of sift down: the hole at index always moves to its best child
+ * until it reaches a leaf, then elem is sifted up from there. elem usually
+ * belongs near the bottom (it was the last element), so this saves the
+ * comparison against elem on every level.
+ */
+template <u32 D, typename T, typename CompareT, typename OnMoveT>
+inline void heap_sift_hole_down(T* data, u32 num_elements, u32 index,
+                                const T& elem, CompareT& compare,
+                                OnMoveT&& on_move)
+{
+    while (true)
+    {
+        const u32 first_child = index * D + 1u;
+        if (first_child >= num_elements)
+        {
+            break;
+        }
+
+        const u32 last_child = std::min(first_child + D, num_elements);
+        u32       best       = first_child;
+        for (u32 child = first_child + 1u; child < last_child; child++)
+        {
+            best = compare(data[child], data[best]) ? child : best;
+        }
+
+        data[index] = data[best];
+        on_move(data[index], index);
+        index = best;
+    }
+
+    data[index] = elem;
+    heap_sift_up<D>(data, index, compare, on_move);
+}
+
+struct HeapNoMove
+{
+    template <typename T>
+    inline void operator()(const T&, u32) const
+    {
+    }
+};
+
+} // namespace Detail
+
+/*
+ * DaryHeap
+ *
+ * D-ary heap priority queue over an Array. CompareT(a, b) returns true when a
+ * should come out before b: std::less gives a min heap, std::greater a max
+ * heap. A 4-ary heap halves the depth of a binary heap and its children sit
+ * next to each other in memory.
+ */
+template <typename T, u32 D = 4u, typename CompareT = std::less<>>
+    requires(D >= 2u)
+class DaryHeap final
+{
+  public:
+    Array<T> data;
+    CompareT compare;
+
+  public:
+    explicit DaryHeap(IAllocator& allocator, u32 reservedNum = 16u,
+                      CompareT compare = {})
+        : data(allocator, reservedNum), compare(compare)
+    {
+    }
+
+    u32 Size() const { return data.NumElements; }
+
+    bool is_empty() const { return data.NumElements == 0u; }
+
+    void clear() { data.NumElements = 0u; }
+
+    const T& top() const
+    {
+        assert(!is_empty());
+        return data[0];
+    }
+
+    void push(const T& elem)
+    {
+        data.Add(elem);
+        Detail::heap_sift_up<D>(data.Data, data.NumElements - 1u, compare,
+                                Detail::HeapNoMove());
+    }
+
+    T pop()
+    {
+        assert(!is_empty());
+
+        T result = data[0];
+
+        data.NumElements--;
+        if (data.NumElements > 0u)
+        {
+            Detail::heap_sift_hole_down<D>(data.Data, data.NumElements, 0u,
+                                           data.Data[data.NumElements],
+                                           compare, Detail::HeapNoMove());
+        }
+
+        return result;
+    }
+
+    /*
+     * Replaces the content with the elements of the view, builds the heap
+     * bottom up in O(n).
+     */
+    void heapify(View<const T> elems)
+    {
+        clear();
+        data.Append(elems);
+
+        if (data.NumElements < 2u)
+        {
+            return;
+        }
+
+        const u32 last_parent = (data.NumElements - 2u) / D;
+        for (i32 i = (i32)last_parent; i >= 0; i--)
+        {
+            Detail::heap_sift_down<D>(data.Data, data.NumElements, (u32)i,
+                                      compare, Detail::HeapNoMove());
+        }
+    }
+};
+
+/*
+ * IndexedDaryHeap
+ *
+ * D-ary heap over (id, priority) pairs which keeps an id -> heap position map,
+ * so the priority of a queued id can be changed in O(log n) (decrease-key).
+ * Ids index the position map directly and should be dense (slot indices, node
+ * ids, ...).
+ */
+template <typename PriorityT, u32 D = 4u, typename CompareT = std::less<>>
+    requires(D >= 2u)
+class IndexedDaryHeap final
+{
+  public:
+    static constexpr u32 InvalidPosition = ~0u;
+
+    struct Entry
+    {
+        PriorityT priority;
+        u32       id;
+    };
+
+    struct EntryCompare
+    {
+        CompareT compare;
+
+        inline bool operator()(const Entry& a, const Entry& b)
+        {
+            return compare(a.priority, b.priority);
+        }
+    };
+
+  public:
+    Array<Entry> entries;
+    Array<u32>   positions;
+    EntryCompare compare;
+
+  public:
+    explicit IndexedDaryHeap(IAllocator& allocator, u32 reservedNum = 16u,
+                             CompareT compare = {})
+        : entries(allocator, reservedNum), positions(allocator, reservedNum),
+          compare{compare}
+    {
+    }
+
+    u32 Size() const { return entries.NumElements; }
+
+    bool is_empty() const { return entries.NumElements == 0u; }
+
+    void clear()
+    {
+        for (u32 i = 0; i < entries.NumElements; i++)
+        {
+            positions[entries[i].id] = InvalidPosition;
+        }
+        entries.NumElements = 0u;
+    }
+
+    bool contains(u32 id) const
+    {
+        return id < positions.NumElements && positions[id] != InvalidPosition;
+    }
+
+    const Entry& top() const
+    {
+        assert(!is_empty());
+        return entries[0];
+    }
+
+    /*
+     * Queues id, or changes its priority if it is already queued.
+     */
+    void push(u32 id, const PriorityT& priority)
+    {
+        if (contains(id))
+        {
+            update(id, priority);
+            return;
+        }
+
+        ensure_id(id);
+
+        entries.Add({priority, id});
+        Detail::heap_sift_up<D>(entries.Data, entries.NumElements - 1u,
+                                compare, position_tracker());
+    }
+
+    /*
+     * Changes the priority of a queued id, moves it up or down as needed.
+     */
+    void update(u32 id, const PriorityT& priority)
+    {
+        assert(contains(id));
+
+        const u32   index = positions[id];
+        const Entry old   = entries[index];
+
+        entries[index].priority = priority;
+
+        if (compare(entries[index], old))
+        {
+            Detail::heap_sift_up<D>(entries.Data, index, compare,
+                                    position_tracker());
+        }
+        else
+        {
+            Detail::heap_sift_down<D>(entries.Data, entries.NumElements, index,
+                                      compare, position_tracker());
+        }
+    }
+
+    Entry pop()
+    {
+        assert(!is_empty());
+
+        const Entry result   = entries[0];
+        positions[result.id] = InvalidPosition;
+
+        entries.NumElements--;
+        if (entries.NumElements > 0u)
+        {
+            Detail::heap_sift_hole_down<D>(
+                entries.Data, entries.NumElements, 0u,
+                entries.Data[entries.NumElements], compare, position_tracker());
+        }
+
+        return result;
+    }
+
+    /*
+     * Replaces the content with the given ids/priorities, builds the heap
+     * bottom up in O(n). Ids must be unique.
+     */
+    void heapify(View<const u32> ids, View<const PriorityT> priorities)
+    {
+        assert(ids.NumElements == priorities.NumElements);
+
+        clear();
+        for (u32 i = 0; i < ids.NumElements; i++)
+        {
+            assert(!contains(ids[i]));
+
+            ensure_id(ids[i]);
+            entries.Add({priorities[i], ids[i]});
+            positions[ids[i]] = i;
+        }
+
+        if (entries.NumElements < 2u)
+        {
+            return;
+        }
+
+        const u32 last_parent = (entries.NumElements - 2u) / D;
+        for (i32 i = (i32)last_parent; i >= 0; i--)
+        {
+            Detail::heap_sift_down<D>(entries.Data, entries.NumElements,
+                                      (u32)i, compare, position_tracker());
+        }
+    }
+
+  private:
+    inline auto position_tracker()
+    {
+        return [this](const Entry& entry, u32 index)
+        { positions[entry.id] = index; };
+    }
+
+    void ensure_id(u32 id)
+    {
+        if (id < positions.NumElements)
+        {
+            return;
+        }
+
+        const u32 old_size = positions.NumElements;
+        positions.add_no_init(id + 1u - old_size);
+        for (u32 i = old_size; i < positions.NumElements; i++)
+        {
+            positions[i] = InvalidPosition;
+        }
+    }
+};
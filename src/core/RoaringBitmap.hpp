@@ -0,0 +1,1043 @@
+#pragma once
+
+#include "Allocators.hpp"
+#include "BitList.hpp"
+#include "BitOps.hpp"
+#include "Containers.hpp"
+#include "core.hpp"
+
+#include <cstring>
+
+/*
+ * RoaringBitmap
+ *
+ * Compressed set of u32 ids for sparse, huge id spaces (e.g. the 2^24 index
+ * space of BindlessHandle). Ids are split in 64K blocks by their high 16 bits
+ * and every non empty block gets a container, in the representation that is
+ * smallest for its content:
+ *
+ *  ARRAY   sorted u16 values, up to 4096 of them (8KB at most)
+ *  BITMAP  1024 u64 words, 65536 bits (8KB)
+ *  RUN     sorted [start, start + length] runs, 4 bytes each
+ *
+ * add/remove keep blocks as arrays or bitmaps, run_optimize() turns the
+ * containers that compress better into runs (call it after bulk changes).
+ *
+ *  RoaringBitmap visible(arena);
+ *  visible.add(handle.index);
+ *  roaring_and(result, visible, resident);
+ *
+ * Copies are explicit (copy_from), containers own their memory.
+ */
+class RoaringBitmap final
+{
+  public:
+    static constexpr u32 MaxArraySize = 4096u;
+    static constexpr u32 BitmapWords  = 1024u;
+
+    enum class EContainerType : u8
+    {
+        ARRAY,
+        BITMAP,
+        RUN
+    };
+
+    // covers start .. start + length, both inclusive
+    struct Run
+    {
+        u16 start;
+        u16 length;
+    };
+
+    struct Container
+    {
+        void*          data          = nullptr;
+        MemoryHandle   memory_handle = {};
+        u32            cardinality   = 0u;
+        u32            size          = 0u; // values or runs
+        u32            capacity      = 0u; // values or runs
+        u16            key           = 0u;
+        EContainerType type          = EContainerType::ARRAY;
+
+        inline u16* values() const { return static_cast<u16*>(data); }
+        inline u64* words() const { return static_cast<u64*>(data); }
+        inline Run* runs() const { return static_cast<Run*>(data); }
+    };
+
+  public:
+    Array<Container> containers; // sorted by key
+
+    IAllocator& _Allocator;
+
+  public:
+    explicit RoaringBitmap(IAllocator& allocator, u32 reservedContainers = 4u)
+        : containers(allocator, reservedContainers), _Allocator(allocator)
+    {
+    }
+
+    RoaringBitmap(const RoaringBitmap&)            = delete;
+    RoaringBitmap& operator=(const RoaringBitmap&) = delete;
+
+    ~RoaringBitmap() { clear(); }
+
+    void clear()
+    {
+        for (u32 i = 0; i < containers.NumElements; i++)
+        {
+            _Allocator.Free(containers[i].memory_handle);
+        }
+        containers.NumElements = 0u;
+    }
+
+    void copy_from(const RoaringBitmap& other)
+    {
+        assert(&other != this);
+
+        clear();
+        for (u32 i = 0; i < other.containers.NumElements; i++)
+        {
+            append_copy(other.containers[i]);
+        }
+    }
+
+    /*
+     * Returns true if value wasn't part of the set.
+     */
+    bool add(u32 value)
+    {
+        const u16 key = (u16)(value >> 16);
+        const u16 low = (u16)value;
+
+        u32 index = lower_bound(key);
+        if (index == containers.NumElements || containers[index].key != key)
+        {
+            Container container;
+            container.key = key;
+            allocate(container, EContainerType::ARRAY, 4u);
+            insert_container(index, container);
+        }
+
+        return container_add(containers[index], low);
+    }
+
+    /*
+     * Returns true if value was part of the set.
+     */
+    bool remove(u32 value)
+    {
+        const i32 index = find_container((u16)(value >> 16));
+        if (index < 0)
+        {
+            return false;
+        }
+
+        Container& container = containers[(u32)index];
+        if (!container_remove(container, (u16)value))
+        {
+            return false;
+        }
+
+        if (container.cardinality == 0u)
+        {
+            _Allocator.Free(container.memory_handle);
+            remove_container((u32)index);
+        }
+        return true;
+    }
+
+    [[nodiscard]] bool contains(u32 value) const
+    {
+        const i32 index = find_container((u16)(value >> 16));
+        return index >= 0 && container_contains(containers[(u32)index], (u16)value);
+    }
+
+    [[nodiscard]] u64 cardinality() const
+    {
+        u64 Result = 0u;
+        for (u32 i = 0; i < containers.NumElements; i++)
+        {
+            Result += containers[i].cardinality;
+        }
+        return Result;
+    }
+
+    [[nodiscard]] bool is_empty() const { return containers.NumElements == 0u; }
+
+    // Largest value in the set, the set must not be empty
+    [[nodiscard]] u32 max_value() const
+    {
+        assert(!is_empty());
+
+        const Container& container = containers[containers.NumElements - 1u];
+        return ((u32)container.key << 16) | container_max(container);
+    }
+
+    // Container memory in bytes, without the container array itself
+    [[nodiscard]] u64 size_bytes() const
+    {
+        u64 Result = 0u;
+        for (u32 i = 0; i < containers.NumElements; i++)
+        {
+            Result += container_bytes(containers[i].type, containers[i].size);
+        }
+        return Result;
+    }
+
+    /*
+     * Calls func(u32 value) for every value, in increasing order.
+     */
+    template <typename FuncT>
+    void for_each(FuncT&& func) const
+    {
+        for (u32 i = 0; i < containers.NumElements; i++)
+        {
+            const Container& container = containers[i];
+            const u32        high      = (u32)container.key << 16;
+
+            switch (container.type)
+            {
+            case EContainerType::ARRAY:
+                for (u32 v = 0; v < container.size; v++)
+                {
+                    func(high | container.values()[v]);
+                }
+                break;
+            case EContainerType::BITMAP:
+                for (u32 w = 0; w < BitmapWords; w++)
+                {
+                    for (u64 bits = container.words()[w]; bits != 0u;
+                         bits &= bits - 1u)
+                    {
+                        func(high | (w * 64u + (u32)__builtin_ctzll(bits)));
+                    }
+                }
+                break;
+            case EContainerType::RUN:
+                for (u32 r = 0; r < container.size; r++)
+                {
+                    const Run run = container.runs()[r];
+                    for (u32 v = run.start; v <= (u32)run.start + run.length; v++)
+                    {
+                        func(high | v);
+                    }
+                }
+                break;
+            }
+        }
+    }
+
+    /*
+     * Converts every container to runs where that is the smallest
+     * representation, and runs back to arrays/bitmaps where it no longer is.
+     */
+    void run_optimize()
+    {
+        for (u32 i = 0; i < containers.NumElements; i++)
+        {
+            Container& container = containers[i];
+
+            u64        scratch[BitmapWords];
+            const u64* words = container_words(container, scratch);
+
+            const u32 num_runs   = count_runs(words);
+            const u32 run_bytes  = container_bytes(EContainerType::RUN, num_runs);
+            const u32 flat_bytes = container.cardinality <= MaxArraySize
+                                       ? container.cardinality * (u32)sizeof(u16)
+                                       : BitmapWords * (u32)sizeof(u64);
+
+            if (run_bytes < flat_bytes)
+            {
+                if (container.type != EContainerType::RUN)
+                {
+                    Container runs;
+                    runs.key = container.key;
+                    allocate(runs, EContainerType::RUN, num_runs);
+                    fill_runs(runs, words);
+                    replace(container, runs);
+                }
+            }
+            else if (container.type == EContainerType::RUN)
+            {
+                set_from_words(container, words, container.cardinality);
+            }
+        }
+    }
+
+    // ---------------- Internals, also used by the set operations ----------------
+
+    // Index of the first container with a key not less than key
+    u32 lower_bound(u16 key) const
+    {
+        u32 lo = 0u;
+        u32 hi = containers.NumElements;
+        while (lo < hi)
+        {
+            const u32 mid = (lo + hi) / 2u;
+            if (containers[mid].key < key)
+            {
+                lo = mid + 1u;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+    i32 find_container(u16 key) const
+    {
+        const u32 index = lower_bound(key);
+        return index < containers.NumElements && containers[index].key == key
+                   ? (i32)index
+                   : -1;
+    }
+
+    // Keys must be appended in increasing order
+    Container& append_container(u16 key)
+    {
+        assert(containers.NumElements == 0u ||
+               containers[containers.NumElements - 1u].key < key);
+
+        containers.add_no_init(1u);
+
+        Container& Result = containers[containers.NumElements - 1u];
+        Result            = Container();
+        Result.key        = key;
+        return Result;
+    }
+
+    void append_copy(const Container& src)
+    {
+        Container& dst = append_container(src.key);
+        allocate(dst, src.type, src.type == EContainerType::BITMAP ? 0u : src.size);
+        memcpy(dst.data, src.data, container_bytes(src.type, src.size));
+        dst.size        = src.size;
+        dst.cardinality = src.cardinality;
+    }
+
+    void allocate(Container& container, EContainerType type, u32 capacity)
+    {
+        container.type     = type;
+        container.size     = 0u;
+        container.capacity = type == EContainerType::BITMAP ? 0u : capacity;
+
+        const u32 bytes = std::max(container_bytes(type, container.capacity), 8u);
+
+        container.memory_handle = _Allocator.Allocate(bytes, {true, 64u});
+        assert(container.memory_handle.is_valid());
+        container.data = _Allocator.HandleToPtr(container.memory_handle);
+    }
+
+    /*
+     * Stores the bits of words in container as an array or a bitmap,
+     * depending on the cardinality.
+     */
+    void set_from_words(Container& container, const u64* words, u32 cardinality)
+    {
+        Container Result;
+        Result.key = container.key;
+
+        if (cardinality <= MaxArraySize)
+        {
+            allocate(Result, EContainerType::ARRAY, cardinality);
+            u16* out = Result.values();
+            for (u32 w = 0; w < BitmapWords; w++)
+            {
+                for (u64 bits = words[w]; bits != 0u; bits &= bits - 1u)
+                {
+                    *out++ = (u16)(w * 64u + (u32)__builtin_ctzll(bits));
+                }
+            }
+            Result.size = cardinality;
+        }
+        else
+        {
+            allocate(Result, EContainerType::BITMAP, 0u);
+            memcpy(Result.words(), words, BitmapWords * sizeof(u64));
+        }
+        Result.cardinality = cardinality;
+
+        replace(container, Result);
+    }
+
+    /*
+     * Bits of the container as 1024 words: bitmaps are returned directly,
+     * arrays and runs are expanded into scratch.
+     */
+    static const u64* container_words(const Container& container,
+                                      u64 (&scratch)[BitmapWords])
+    {
+        if (container.type == EContainerType::BITMAP)
+        {
+            return container.words();
+        }
+
+        memset(scratch, 0, sizeof(scratch));
+        if (container.type == EContainerType::ARRAY)
+        {
+            for (u32 v = 0; v < container.size; v++)
+            {
+                const u16 value = container.values()[v];
+                scratch[value / 64u] |= 1ull << (value % 64u);
+            }
+        }
+        else
+        {
+            for (u32 r = 0; r < container.size; r++)
+            {
+                const Run run = container.runs()[r];
+                set_range(scratch, run.start, (u32)run.start + run.length + 1u);
+            }
+        }
+        return scratch;
+    }
+
+    static bool container_contains(const Container& container, u16 value)
+    {
+        switch (container.type)
+        {
+        case EContainerType::ARRAY:
+        {
+            const u32 index = array_lower_bound(container, value);
+            return index < container.size && container.values()[index] == value;
+        }
+        case EContainerType::BITMAP:
+            return (container.words()[value / 64u] >> (value % 64u)) & 1u;
+        case EContainerType::RUN:
+        {
+            // last run starting at or before value
+            u32 lo = 0u;
+            u32 hi = container.size;
+            while (lo < hi)
+            {
+                const u32 mid = (lo + hi) / 2u;
+                if (container.runs()[mid].start <= value)
+                {
+                    lo = mid + 1u;
+                }
+                else
+                {
+                    hi = mid;
+                }
+            }
+            if (lo == 0u)
+            {
+                return false;
+            }
+            const Run run = container.runs()[lo - 1u];
+            return value - run.start <= run.length;
+        }
+        }
+        return false;
+    }
+
+    static u32 container_bytes(EContainerType type, u32 size)
+    {
+        switch (type)
+        {
+        case EContainerType::ARRAY:
+            return size * (u32)sizeof(u16);
+        case EContainerType::BITMAP:
+            return BitmapWords * (u32)sizeof(u64);
+        case EContainerType::RUN:
+            return size * (u32)sizeof(Run);
+        }
+        return 0u;
+    }
+
+  private:
+    bool container_add(Container& container, u16 value)
+    {
+        if (container.type == EContainerType::RUN)
+        {
+            if (container_contains(container, value))
+            {
+                return false;
+            }
+            unpack_runs(container);
+        }
+
+        if (container.type == EContainerType::BITMAP)
+        {
+            u64&      word = container.words()[value / 64u];
+            const u64 bit  = 1ull << (value % 64u);
+            if (word & bit)
+            {
+                return false;
+            }
+            word |= bit;
+            container.cardinality++;
+            return true;
+        }
+
+        const u32 index = array_lower_bound(container, value);
+        if (index < container.size && container.values()[index] == value)
+        {
+            return false;
+        }
+
+        if (container.size == MaxArraySize)
+        {
+            array_to_bitmap(container);
+            return container_add(container, value);
+        }
+
+        if (container.size == container.capacity)
+        {
+            grow_array(container, std::min(container.capacity * 2u, MaxArraySize));
+        }
+
+        u16* values = container.values();
+        memmove(&values[index + 1u], &values[index],
+                (container.size - index) * sizeof(u16));
+        values[index] = value;
+
+        container.size++;
+        container.cardinality++;
+        return true;
+    }
+
+    bool container_remove(Container& container, u16 value)
+    {
+        if (!container_contains(container, value))
+        {
+            return false;
+        }
+
+        if (container.type == EContainerType::RUN)
+        {
+            unpack_runs(container);
+        }
+
+        if (container.type == EContainerType::BITMAP)
+        {
+            container.words()[value / 64u] &= ~(1ull << (value % 64u));
+            container.cardinality--;
+
+            if (container.cardinality <= MaxArraySize)
+            {
+                set_from_words(container, container.words(), container.cardinality);
+            }
+            return true;
+        }
+
+        const u32 index  = array_lower_bound(container, value);
+        u16*      values = container.values();
+        memmove(&values[index], &values[index + 1u],
+                (container.size - index - 1u) * sizeof(u16));
+
+        container.size--;
+        container.cardinality--;
+        return true;
+    }
+
+    static u16 container_max(const Container& container)
+    {
+        switch (container.type)
+        {
+        case EContainerType::ARRAY:
+            return container.values()[container.size - 1u];
+        case EContainerType::BITMAP:
+            for (u32 w = BitmapWords; w-- > 0u;)
+            {
+                if (container.words()[w] != 0u)
+                {
+                    return (u16)(w * 64u + 63u -
+                                 (u32)__builtin_clzll(container.words()[w]));
+                }
+            }
+            break;
+        case EContainerType::RUN:
+        {
+            const Run run = container.runs()[container.size - 1u];
+            return (u16)(run.start + run.length);
+        }
+        }
+        return 0u;
+    }
+
+    static u32 array_lower_bound(const Container& container, u16 value)
+    {
+        u32 lo = 0u;
+        u32 hi = container.size;
+        while (lo < hi)
+        {
+            const u32 mid = (lo + hi) / 2u;
+            if (container.values()[mid] < value)
+            {
+                lo = mid + 1u;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+    // Sets bits [begin, end)
+    static void set_range(u64* words, u32 begin, u32 end)
+    {
+        const u32 first_word = begin / 64u;
+        const u32 last_word  = (end - 1u) / 64u;
+
+        const u64 first_mask = ~0ull << (begin % 64u);
+        const u64 last_mask  = ~0ull >> (63u - (end - 1u) % 64u);
+
+        if (first_word == last_word)
+        {
+            words[first_word] |= first_mask & last_mask;
+            return;
+        }
+
+        words[first_word] |= first_mask;
+        for (u32 w = first_word + 1u; w < last_word; w++)
+        {
+            words[w] = ~0ull;
+        }
+        words[last_word] |= last_mask;
+    }
+
+    // Number of runs of set bits: every 0 -> 1 transition starts one
+    static u32 count_runs(const u64* words)
+    {
+        u32 Result = 0u;
+        u64 carry  = 0u; // top bit of the previous word
+        for (u32 w = 0; w < BitmapWords; w++)
+        {
+            const u64 bits = words[w];
+            Result += (u32)__builtin_popcountll(bits & ~((bits << 1) | carry));
+            carry = bits >> 63;
+        }
+        return Result;
+    }
+
+    static void fill_runs(Container& container, const u64* words)
+    {
+        u32 cardinality = 0u;
+        u32 num_runs    = 0u;
+
+        u32 value = 0u;
+        while (value < BitmapWords * 64u)
+        {
+            // skip to the next set bit
+            u32 w    = value / 64u;
+            u64 bits = words[w] & (~0ull << (value % 64u));
+            while (bits == 0u && ++w < BitmapWords)
+            {
+                bits = words[w];
+            }
+            if (w == BitmapWords)
+            {
+                break;
+            }
+            const u32 start = w * 64u + (u32)__builtin_ctzll(bits);
+
+            // and to the next clear one
+            bits = ~words[w] & (~0ull << (start % 64u));
+            while (bits == 0u && ++w < BitmapWords)
+            {
+                bits = ~words[w];
+            }
+            const u32 end =
+                w == BitmapWords ? BitmapWords * 64u : w * 64u + (u32)__builtin_ctzll(bits);
+
+            assert(num_runs < container.capacity);
+            container.runs()[num_runs++] = {(u16)start, (u16)(end - start - 1u)};
+            cardinality += end - start;
+            value = end;
+        }
+
+        container.size        = num_runs;
+        container.cardinality = cardinality;
+    }
+
+    void array_to_bitmap(Container& container)
+    {
+        Container Result;
+        Result.key = container.key;
+        allocate(Result, EContainerType::BITMAP, 0u);
+
+        u64* words = Result.words();
+        for (u32 v = 0; v < container.size; v++)
+        {
+            const u16 value = container.values()[v];
+            words[value / 64u] |= 1ull << (value % 64u);
+        }
+        Result.cardinality = container.cardinality;
+
+        replace(container, Result);
+    }
+
+    void unpack_runs(Container& container)
+    {
+        u64 scratch[BitmapWords];
+        set_from_words(container, container_words(container, scratch),
+                       container.cardinality);
+    }
+
+    void grow_array(Container& container, u32 new_capacity)
+    {
+        Container Result;
+        Result.key = container.key;
+        allocate(Result, EContainerType::ARRAY, new_capacity);
+        memcpy(Result.values(), container.values(), container.size * sizeof(u16));
+        Result.size        = container.size;
+        Result.cardinality = container.cardinality;
+
+        replace(container, Result);
+    }
+
+    void replace(Container& container, const Container& with)
+    {
+        _Allocator.Free(container.memory_handle);
+        container = with;
+    }
+
+    void insert_container(u32 index, const Container& container)
+    {
+        const u32 num_tail = containers.NumElements - index;
+        containers.add_no_init(1u);
+        memmove(&containers.Data[index + 1u], &containers.Data[index],
+                num_tail * sizeof(Container));
+        containers.Data[index] = container;
+    }
+
+    void remove_container(u32 index)
+    {
+        const u32 num_tail = containers.NumElements - index - 1u;
+        memmove(&containers.Data[index], &containers.Data[index + 1u],
+                num_tail * sizeof(Container));
+        containers.NumElements--;
+    }
+};
+
+namespace Detail
+{
+
+enum class ERoaringOp : u32
+{
+    OR,
+    AND,
+    ANDNOT
+};
+
+// Sorted u16 merges, return the number of values written to out
+inline u32 roaring_array_or(const u16* a, u32 size_a, const u16* b, u32 size_b,
+                            u16* out)
+{
+    u32 i = 0u, j = 0u, n = 0u;
+    while (i < size_a && j < size_b)
+    {
+        const u16 va = a[i];
+        const u16 vb = b[j];
+        out[n++]     = va < vb ? va : vb;
+        i += va <= vb;
+        j += vb <= va;
+    }
+    while (i < size_a)
+    {
+        out[n++] = a[i++];
+    }
+    while (j < size_b)
+    {
+        out[n++] = b[j++];
+    }
+    return n;
+}
+
+inline u32 roaring_array_and(const u16* a, u32 size_a, const u16* b, u32 size_b,
+                             u16* out)
+{
+    u32 i = 0u, j = 0u, n = 0u;
+    while (i < size_a && j < size_b)
+    {
+        const u16 va = a[i];
+        const u16 vb = b[j];
+        if (va == vb)
+        {
+            out[n++] = va;
+        }
+        i += va <= vb;
+        j += vb <= va;
+    }
+    return n;
+}
+
+inline u32 roaring_array_andnot(const u16* a, u32 size_a, const u16* b,
+                                u32 size_b, u16* out)
+{
+    u32 i = 0u, j = 0u, n = 0u;
+    while (i < size_a && j < size_b)
+    {
+        const u16 va = a[i];
+        const u16 vb = b[j];
+        if (va < vb)
+        {
+            out[n++] = va;
+        }
+        i += va <= vb;
+        j += vb <= va;
+    }
+    while (i < size_a)
+    {
+        out[n++] = a[i++];
+    }
+    return n;
+}
+
+inline void roaring_store_array(RoaringBitmap& out, u16 key, const u16* values,
+                                u32 size)
+{
+    if (size == 0u)
+    {
+        return;
+    }
+
+    RoaringBitmap::Container& container = out.append_container(key);
+    out.allocate(container, RoaringBitmap::EContainerType::ARRAY, size);
+    memcpy(container.values(), values, size * sizeof(u16));
+    container.size        = size;
+    container.cardinality = size;
+}
+
+/*
+ * Array containers are merged (or filtered against the other container for
+ * AND/ANDNOT), everything else goes through 8KB bitmaps and the BitOps
+ * kernels.
+ */
+inline void roaring_container_op(ERoaringOp op, RoaringBitmap& out,
+                                 const RoaringBitmap::Container& a,
+                                 const RoaringBitmap::Container& b)
+{
+    using Bitmap = RoaringBitmap;
+    using EType  = RoaringBitmap::EContainerType;
+
+    const bool a_array = a.type == EType::ARRAY;
+    const bool b_array = b.type == EType::ARRAY;
+
+    u16 values[2u * Bitmap::MaxArraySize];
+
+    if (a_array && b_array)
+    {
+        u32 size = 0u;
+        switch (op)
+        {
+        case ERoaringOp::OR:
+            size = roaring_array_or(a.values(), a.size, b.values(), b.size, values);
+            break;
+        case ERoaringOp::AND:
+            size = roaring_array_and(a.values(), a.size, b.values(), b.size, values);
+            break;
+        case ERoaringOp::ANDNOT:
+            size = roaring_array_andnot(a.values(), a.size, b.values(), b.size,
+                                        values);
+            break;
+        }
+
+        if (size <= Bitmap::MaxArraySize)
+        {
+            roaring_store_array(out, a.key, values, size);
+            return;
+        }
+
+        // a union of two big arrays, store it as a bitmap
+        u64 words[Bitmap::BitmapWords] = {};
+        for (u32 v = 0; v < size; v++)
+        {
+            words[values[v] / 64u] |= 1ull << (values[v] % 64u);
+        }
+        RoaringBitmap::Container& container = out.append_container(a.key);
+        out.set_from_words(container, words, size);
+        return;
+    }
+
+    // filter the array side, the result is never bigger than it
+    if (op != ERoaringOp::OR && (a_array || (b_array && op == ERoaringOp::AND)))
+    {
+        const RoaringBitmap::Container& array = a_array ? a : b;
+        const RoaringBitmap::Container& other = a_array ? b : a;
+        const bool                      keep  = op == ERoaringOp::AND;
+
+        u32 size = 0u;
+        for (u32 v = 0; v < array.size; v++)
+        {
+            const u16 value = array.values()[v];
+            values[size]    = value;
+            size += Bitmap::container_contains(other, value) == keep;
+        }
+        roaring_store_array(out, a.key, values, size);
+        return;
+    }
+
+    static constexpr u32 NumBlocks = Bitmap::BitmapWords / 2u;
+    static constexpr BitOps::EBinaryOp BinaryOps[] = {
+        BitOps::EBinaryOp::OR, BitOps::EBinaryOp::AND, BitOps::EBinaryOp::ANDNOT};
+
+    alignas(16) u64 scratch_a[Bitmap::BitmapWords];
+    alignas(16) u64 scratch_b[Bitmap::BitmapWords];
+    const u64*      words_a = Bitmap::container_words(a, scratch_a);
+    const u64*      words_b = Bitmap::container_words(b, scratch_b);
+
+    alignas(16) u64 words[Bitmap::BitmapWords];
+    BitOps::kernels().binary[(u32)BinaryOps[(u32)op]](
+        (u8*)words, (const u8*)words_a, (const u8*)words_b, NumBlocks);
+
+    const u32 cardinality =
+        (u32)BitOps::kernels().popcount((const u8*)words, nullptr, NumBlocks, {});
+    if (cardinality == 0u)
+    {
+        return;
+    }
+
+    RoaringBitmap::Container& container = out.append_container(a.key);
+    out.set_from_words(container, words, cardinality);
+}
+
+inline void roaring_op(ERoaringOp op, RoaringBitmap& out, const RoaringBitmap& a,
+                       const RoaringBitmap& b)
+{
+    assert(&out != &a && &out != &b);
+    out.clear();
+
+    const u32 size_a = a.containers.NumElements;
+    const u32 size_b = b.containers.NumElements;
+
+    u32 i = 0u, j = 0u;
+    while (i < size_a && j < size_b)
+    {
+        const RoaringBitmap::Container& ca = a.containers[i];
+        const RoaringBitmap::Container& cb = b.containers[j];
+
+        if (ca.key == cb.key)
+        {
+            roaring_container_op(op, out, ca, cb);
+            i++;
+            j++;
+        }
+        else if (ca.key < cb.key)
+        {
+            if (op != ERoaringOp::AND)
+            {
+                out.append_copy(ca);
+            }
+            i++;
+        }
+        else
+        {
+            if (op == ERoaringOp::OR)
+            {
+                out.append_copy(cb);
+            }
+            j++;
+        }
+    }
+
+    if (op != ERoaringOp::AND)
+    {
+        for (; i < size_a; i++)
+        {
+            out.append_copy(a.containers[i]);
+        }
+    }
+    if (op == ERoaringOp::OR)
+    {
+        for (; j < size_b; j++)
+        {
+            out.append_copy(b.containers[j]);
+        }
+    }
+}
+
+} // namespace Detail
+
+// out = a | b, out must not be one of the inputs
+inline void roaring_or(RoaringBitmap& out, const RoaringBitmap& a,
+                       const RoaringBitmap& b)
+{
+    Detail::roaring_op(Detail::ERoaringOp::OR, out, a, b);
+}
+
+// out = a & b
+inline void roaring_and(RoaringBitmap& out, const RoaringBitmap& a,
+                        const RoaringBitmap& b)
+{
+    Detail::roaring_op(Detail::ERoaringOp::AND, out, a, b);
+}
+
+// out = a & ~b
+inline void roaring_andnot(RoaringBitmap& out, const RoaringBitmap& a,
+                           const RoaringBitmap& b)
+{
+    Detail::roaring_op(Detail::ERoaringOp::ANDNOT, out, a, b);
+}
+
+/*
+ * Replaces the content of out with the set bits of list. Blocks are gathered
+ * in a bitmap and stored once complete, so this is linear in the list size.
+ */
+template <u32 ChunkSize>
+void roaring_from_bitlist(RoaringBitmap& out, const DynamicBitlist<ChunkSize>& list)
+{
+    out.clear();
+
+    u64 words[RoaringBitmap::BitmapWords] = {};
+    u32 cardinality                       = 0u;
+    u32 key                               = 0u;
+
+    const auto flush = [&]()
+    {
+        if (cardinality > 0u)
+        {
+            RoaringBitmap::Container& container = out.append_container((u16)key);
+            out.set_from_words(container, words, cardinality);
+            memset(words, 0, sizeof(words));
+            cardinality = 0u;
+        }
+    };
+
+    bitlist_for_each_set(list,
+                         [&](u32 index)
+                         {
+                             if (index >> 16 != key)
+                             {
+                                 flush();
+                                 key = index >> 16;
+                             }
+                             const u32 low = index & 0xffffu;
+                             words[low / 64u] |= 1ull << (low % 64u);
+                             cardinality++;
+                         });
+    flush();
+}
+
+/*
+ * Replaces the content of list with the values of bitmap, growing it to hold
+ * the largest one.
+ */
+template <u32 ChunkSize>
+void roaring_to_bitlist(const RoaringBitmap& bitmap, DynamicBitlist<ChunkSize>& list)
+{
+    using Chunk = typename DynamicBitlist<ChunkSize>::Chunk;
+
+    if (!bitmap.is_empty())
+    {
+        list.resize(bitmap.max_value() + 1u);
+    }
+
+    for (u32 i = 0; i < list.num_chunks(); i++)
+    {
+        list.chunks[i] = Chunk();
+    }
+
+    bitmap.for_each(
+        [&](u32 value)
+        {
+            const u32 chunk_idx = value / DynamicBitlist<ChunkSize>::BitsPerChunk;
+            list.chunks[chunk_idx].set_bit(value -
+                                           chunk_idx * DynamicBitlist<ChunkSize>::BitsPerChunk);
+        });
+
+    list.rebuild_summaries();
+}
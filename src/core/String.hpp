@@ -0,0 +1,368 @@
+#pragma once
+
+#include "Allocators.hpp"
+#include "Containers.hpp"
+#include "Hash.hpp"
+#include "PerfectHash.hpp"
+#include "core.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <shared_mutex>
+#include <string_view>
+
+/*
+ * StringView
+ *
+ * Non owning (pointer, size) pair. Not necessarily null terminated.
+ */
+struct StringView
+{
+    const char* Data = nullptr;
+    u32         Size = 0u;
+
+    constexpr StringView() = default;
+    constexpr StringView(const char* str)
+        : Data(str), Size(str ? (u32)std::char_traits<char>::length(str) : 0u)
+    {
+    }
+    constexpr StringView(const char* str, u32 size) : Data(str), Size(size) {}
+    constexpr StringView(std::string_view str)
+        : Data(str.data()), Size((u32)str.size())
+    {
+    }
+
+    constexpr operator std::string_view() const { return {Data, Size}; }
+
+    constexpr bool is_empty() const { return Size == 0u; }
+
+    constexpr bool operator==(StringView other) const
+    {
+        return std::string_view(*this) == std::string_view(other);
+    }
+
+    // Same as Hash<StringView>
+    inline u64 hash() const { return hash_bytes(Data, Size); }
+
+    // For compile time tables (PerfectHash), differs from hash()
+    constexpr u64 static_hash() const
+    {
+        return Detail::static_hash(std::string_view(*this));
+    }
+};
+
+template <>
+struct Hash<StringView>
+{
+    inline u64 operator()(StringView str) const { return str.hash(); }
+};
+
+/*
+ * String
+ *
+ * Null terminated copy of a string, allocated from an IAllocator (usually an
+ * arena, Free is a no-op there). Immutable once created.
+ */
+class String final
+{
+  public:
+    char*        Data = nullptr;
+    u32          Size = 0u;
+    IAllocator&  _Allocator;
+    MemoryHandle memory_handle;
+
+  public:
+    explicit String(IAllocator& allocator, StringView str = {})
+        : _Allocator(allocator)
+    {
+        init(str, {});
+    }
+
+    // a + b in a single allocation, e.g. asset directory + file name
+    explicit String(IAllocator& allocator, StringView a, StringView b)
+        : _Allocator(allocator)
+    {
+        init(a, b);
+    }
+
+    String(const String&)            = delete;
+    String& operator=(const String&) = delete;
+
+    ~String() { _Allocator.Free(memory_handle); }
+
+    const char* c_str() const { return Data; }
+
+    StringView view() const { return {Data, Size}; }
+    operator StringView() const { return view(); }
+
+    bool operator==(StringView other) const { return view() == other; }
+
+  private:
+    void init(StringView a, StringView b)
+    {
+        Size          = a.Size + b.Size;
+        memory_handle = _Allocator.Allocate(Size + 1u, {true, alignof(char)});
+        assert(memory_handle.is_valid());
+
+        Data = static_cast<char*>(_Allocator.HandleToPtr(memory_handle));
+        if (a.Size > 0u)
+        {
+            memcpy(Data, a.Data, a.Size);
+        }
+        if (b.Size > 0u)
+        {
+            memcpy(Data + a.Size, b.Data, b.Size);
+        }
+        Data[Size] = '\0';
+    }
+};
+
+/*
+ * Name
+ *
+ * Interned string id. Equal strings interned in the same table get the same
+ * id, so names compare and hash as integers. 0 is the empty/invalid name.
+ */
+struct Name
+{
+    u32 id = 0u;
+
+    constexpr bool is_valid() const { return id != 0u; }
+
+    constexpr bool operator==(const Name&) const = default;
+};
+
+template <>
+struct Hash<Name>
+{
+    inline u64 operator()(Name name) const { return hash_mix(name.id); }
+};
+
+/*
+ * NameTable
+ *
+ * Interning table: every distinct string is copied once into character blocks
+ * taken from the allocator, and gets the next Name id. The id -> string map is
+ * a plain array; string -> id is an open addressing table of ids keyed by the
+ * precomputed string hash.
+ *
+ * All functions are thread safe. Lookups of already interned strings only take
+ * a shared lock, so loaders can intern from several threads.
+ */
+class NameTable final
+{
+  public:
+    static constexpr u32 BlockSize = KB(16);
+
+    struct Entry
+    {
+        u64         hash;
+        const char* data;
+        u32         size;
+    };
+
+  public:
+    Array<Entry> entries; // indexed by Name::id, entry 0 is the empty name
+    Array<u32>   slots;   // Name ids, 0 marks an empty slot
+
+    IAllocator& _Allocator;
+
+    char* block      = nullptr;
+    u32   block_left = 0u;
+
+    mutable std::shared_mutex mutex;
+
+  public:
+    explicit NameTable(IAllocator& allocator, u32 reservedNames = 1024u)
+        : entries(allocator, reservedNames),
+          slots(allocator, round_up_pow2(reservedNames * 2u)),
+          _Allocator(allocator)
+    {
+        entries.Add({StringView().hash(), "", 0u});
+
+        slots.NumElements = slots._NumAllocated;
+        for (u32 i = 0; i < slots.NumElements; i++)
+        {
+            slots[i] = 0u;
+        }
+    }
+
+    Name intern(StringView str)
+    {
+        if (str.is_empty())
+        {
+            return {};
+        }
+
+        const u64 hash = str.hash();
+        {
+            std::shared_lock lock(mutex);
+            const Name found = find_locked(str, hash);
+            if (found.is_valid())
+            {
+                return found;
+            }
+        }
+
+        std::unique_lock lock(mutex);
+
+        // another thread may have interned it in between
+        const Name found = find_locked(str, hash);
+        if (found.is_valid())
+        {
+            return found;
+        }
+
+        // keep the load factor under 1/2
+        if ((entries.NumElements + 1u) * 2u > slots.NumElements)
+        {
+            rehash(slots.NumElements * 2u);
+        }
+
+        const Name name = {entries.NumElements};
+        entries.Add({hash, store_chars(str), str.Size});
+        insert_slot(name.id, hash);
+
+        return name;
+    }
+
+    /*
+     * Name of an already interned string, the empty name otherwise.
+     */
+    Name find(StringView str) const
+    {
+        std::shared_lock lock(mutex);
+        return find_locked(str, str.hash());
+    }
+
+    /*
+     * The returned view stays valid for the lifetime of the table.
+     */
+    StringView to_string(Name name) const
+    {
+        std::shared_lock lock(mutex);
+        assert(name.id < entries.NumElements);
+        return {entries[name.id].data, entries[name.id].size};
+    }
+
+    // Hash of the string itself, stable across runs
+    u64 hash(Name name) const
+    {
+        std::shared_lock lock(mutex);
+        assert(name.id < entries.NumElements);
+        return entries[name.id].hash;
+    }
+
+    u32 Size() const
+    {
+        std::shared_lock lock(mutex);
+        return entries.NumElements - 1u;
+    }
+
+  private:
+    Name find_locked(StringView str, u64 hash) const
+    {
+        const u32 mask = slots.NumElements - 1u;
+        for (u32 slot = (u32)hash & mask;; slot = (slot + 1u) & mask)
+        {
+            const u32 id = slots[slot];
+            if (id == 0u)
+            {
+                return {};
+            }
+
+            const Entry& entry = entries[id];
+            if (entry.hash == hash && entry.size == str.Size &&
+                memcmp(entry.data, str.Data, str.Size) == 0)
+            {
+                return {id};
+            }
+        }
+    }
+
+    void insert_slot(u32 id, u64 hash)
+    {
+        const u32 mask = slots.NumElements - 1u;
+
+        u32 slot = (u32)hash & mask;
+        while (slots[slot] != 0u)
+        {
+            slot = (slot + 1u) & mask;
+        }
+        slots[slot] = id;
+    }
+
+    void rehash(u32 num_slots)
+    {
+        slots.Resize(num_slots);
+        slots.NumElements = num_slots;
+        for (u32 i = 0; i < num_slots; i++)
+        {
+            slots[i] = 0u;
+        }
+
+        for (u32 id = 1u; id < entries.NumElements; id++)
+        {
+            insert_slot(id, entries[id].hash);
+        }
+    }
+
+    // Characters never move once stored, so views handed out stay valid
+    const char* store_chars(StringView str)
+    {
+        const u32 size = str.Size + 1u;
+        char*     dst  = nullptr;
+
+        if (size > BlockSize / 4u)
+        {
+            // big strings get their own allocation instead of wasting the
+            // rest of the current block
+            dst = allocate_chars(size);
+        }
+        else
+        {
+            if (size > block_left)
+            {
+                block      = allocate_chars(BlockSize);
+                block_left = BlockSize;
+            }
+            dst = block;
+            block += size;
+            block_left -= size;
+        }
+
+        memcpy(dst, str.Data, str.Size);
+        dst[str.Size] = '\0';
+        return dst;
+    }
+
+    char* allocate_chars(u32 size)
+    {
+        const MemoryHandle handle = _Allocator.Allocate(size, {true, 1u});
+        if (!handle.is_valid())
+        {
+            // views of interned strings are never checked, don't hand out
+            // null ones
+            fprintf(stderr, "NameTable: out of memory storing %u chars\n", size);
+            abort();
+        }
+        return static_cast<char*>(_Allocator.HandleToPtr(handle));
+    }
+};
+
+/*
+ * Process wide name table. Backed by the heap: the table grows for as long as
+ * the process runs, outgrown entry and slot arrays are freed.
+ */
+inline NameTable& global_names()
+{
+    static HeapAllocator heap;
+    static NameTable     names(heap, 4096u);
+    return names;
+}
+
+inline Name make_name(StringView str) { return global_names().intern(str); }
+
+inline StringView to_string(Name name) { return global_names().to_string(name); }
@@ -1,7 +1,20 @@
 #pragma once
 
-// (Bert): this is on hold for now as there is currently no support for c++26
-// reflection in clang #include <meta>
+#include "../Allocators.hpp"
+#include "../Containers.hpp"
+#include "../core.hpp"
+
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// (Bert): the reflection path is on hold for now as there is currently no
+// support for c++26 reflection in clang #include <meta>
+// Until then the members of a SOA type are declared explicitly through
+// SoaSchema (see SOA_SCHEMA below). Fields are always addressed by member
+// pointer, so the schema can later be generated by reflection without
+// changing the SOA api.
 
 enum ESOA_MEMBERS_STYLE
 {
@@ -11,19 +24,320 @@ enum ESOA_MEMBERS_STYLE
                // (like jai's #using implementation)
 };
 
+/*
+ * Specialize for every type stored in a SOA, Members is a tuple of member
+ * pointers. Every listed member gets its own contiguous stream.
+ */
+template <typename TContainer>
+struct SoaSchema;
+
+#define SOA_SCHEMA(Type, ...)                                                  \
+    template <>                                                                \
+    struct SoaSchema<Type>                                                     \
+    {                                                                          \
+        static constexpr auto Members = std::make_tuple(__VA_ARGS__);          \
+    };
+
+template <typename T>
+struct member_pointer_traits;
+
+template <typename ClassT, typename FieldT>
+struct member_pointer_traits<FieldT ClassT::*>
+{
+    using class_type = ClassT;
+    using field_type = FieldT;
+};
+
+/*
+ * SOA
+ *
+ * Structure of arrays container. Every member listed in SoaSchema<TContainer>
+ * is stored in its own stream, all streams live in a single allocation and
+ * each starts on a cache line so kernels can run over a field with aligned
+ * loads.
+ *
+ * AoS style access goes through a proxy (soa[i]) which loads/stores a full
+ * TContainer or references a single field.
+ */
 template <typename TContainer, ESOA_MEMBERS_STYLE Members = EXPLICIT>
-struct SOA
+class SOA final
 {
+    static_assert(Members == EXPLICIT,
+                  "anonymous members need reflection support");
 
-  private:
-    template <typename T>
-    struct proxy_generator
+  public:
+    using Schema = SoaSchema<TContainer>;
+    using Fields = std::remove_cvref_t<decltype(Schema::Members)>;
+
+    static constexpr u32 NumFields       = std::tuple_size_v<Fields>;
+    static constexpr u32 StreamAlignment = 64u;
+
+    template <u32 I>
+    using field_t = typename member_pointer_traits<
+        std::tuple_element_t<I, Fields>>::field_type;
+
+    template <auto Member>
+    static consteval u32 field_index()
+    {
+        u32 result = NumFields;
+        [&]<size_t... I>(std::index_sequence<I...>)
+        {
+            ((is_member<I, Member>() ? (result = I) : 0u), ...);
+        }(std::make_index_sequence<NumFields>{});
+        return result;
+    }
+
+  public:
+    u32 NumElements = 0;
+
+    u32          _NumAllocated = 0;
+    IAllocator&  _Allocator;
+    MemoryHandle memory_handle;
+
+    u8* streams[NumFields] = {};
+
+  public:
+    explicit SOA(IAllocator& allocator, u32 reservedNum = 0)
+        : _Allocator(allocator)
+    {
+        if (reservedNum > 0)
+        {
+            Resize(reservedNum);
+        }
+    }
+
+    SOA(const SOA&) = delete;
+
+    ~SOA() { _Allocator.Free(memory_handle); }
+
+    u32 Size() const { return NumElements; }
+
+    void Resize(u32 newSize)
+    {
+        const u32 new_size_pow2 = round_up_pow2(newSize);
+
+        u32 offsets[NumFields];
+        u32 total_size = 0u;
+        for_each_field(
+            [&]<u32 I>()
+            {
+                offsets[I] = round_to(total_size, StreamAlignment);
+                total_size = offsets[I] + sizeof(field_t<I>) * new_size_pow2;
+            });
+
+        MemoryHandle new_memory =
+            _Allocator.Allocate(total_size, {true, StreamAlignment});
+        assert(new_memory.is_valid());
+
+        u8* base = static_cast<u8*>(_Allocator.HandleToPtr(new_memory));
+
+        // copy over old streams to their new offsets
+        const u32 num_to_copy = std::min(NumElements, new_size_pow2);
+        for_each_field(
+            [&]<u32 I>()
+            {
+                u8* new_stream = base + offsets[I];
+                if (streams[I] != nullptr)
+                {
+                    memcpy(new_stream, streams[I],
+                           num_to_copy * sizeof(field_t<I>));
+                }
+                streams[I] = new_stream;
+            });
+
+        _Allocator.Free(memory_handle);
+
+        memory_handle = new_memory;
+        _NumAllocated = new_size_pow2;
+        NumElements   = num_to_copy;
+    }
+
+    void Reserve(u32 newAmount)
+    {
+        assert(newAmount != 0u);
+
+        if (newAmount > _NumAllocated)
+        {
+            Resize(newAmount);
+        }
+    }
+
+    void add_no_init(u32 amount)
+    {
+        const u32 requested_size = NumElements + amount;
+        Reserve(requested_size);
+        NumElements = requested_size;
+    }
+
+    u32 Add(const TContainer& elem)
+    {
+        Reserve(NumElements + 1u);
+
+        store(NumElements++, elem);
+
+        return NumElements;
+    }
+
+    /*
+     * Removes the element while keeping the order, moves every stream's tail.
+     */
+    void Erase(u32 index)
+    {
+        assert(index < NumElements);
+
+        const u32 num_tail = NumElements - index - 1u;
+        for_each_field(
+            [&]<u32 I>()
+            {
+                field_t<I>* stream = Field<I>().Data;
+                memmove(&stream[index], &stream[index + 1u],
+                        num_tail * sizeof(field_t<I>));
+            });
+
+        NumElements--;
+    }
+
+    /*
+     * Removes the element by moving the last element into its slot.
+     */
+    void EraseSwap(u32 index)
+    {
+        assert(index < NumElements);
+
+        const u32 last = NumElements - 1u;
+        if (index != last)
+        {
+            for_each_field(
+                [&]<u32 I>()
+                {
+                    field_t<I>* stream = Field<I>().Data;
+                    stream[index]      = stream[last];
+                });
+        }
+
+        NumElements--;
+    }
+
+    // ---------------- Per field streams ----------------
+
+    template <u32 I>
+    View<field_t<I>> Field()
+    {
+        View<field_t<I>> Result = {
+            .Data        = reinterpret_cast<field_t<I>*>(streams[I]),
+            .NumElements = NumElements,
+        };
+        return Result;
+    }
+
+    template <u32 I>
+    View<const field_t<I>> Field() const
+    {
+        View<const field_t<I>> Result = {
+            .Data        = reinterpret_cast<const field_t<I>*>(streams[I]),
+            .NumElements = NumElements,
+        };
+        return Result;
+    }
+
+    template <auto Member>
+        requires(field_index<Member>() < NumFields)
+    View<field_t<field_index<Member>()>> Field()
+    {
+        return Field<field_index<Member>()>();
+    }
+
+    template <auto Member>
+        requires(field_index<Member>() < NumFields)
+    View<const field_t<field_index<Member>()>> Field() const
+    {
+        return Field<field_index<Member>()>();
+    }
+
+    // ---------------- AoS style access ----------------
+
+    TContainer Get(u32 index) const
+    {
+        assert(index < NumElements);
+
+        TContainer Result = {};
+        for_each_field(
+            [&]<u32 I>()
+            {
+                Result.*std::get<I>(Schema::Members) = Field<I>()[index];
+            });
+        return Result;
+    }
+
+    void Set(u32 index, const TContainer& elem)
+    {
+        assert(index < NumElements);
+        store(index, elem);
+    }
+
+    template <typename OwnerT>
+    struct TProxy
     {
-        struct type;
+        OwnerT* owner;
+        u32     index;
+
+        template <auto Member>
+        auto& Get() const
+        {
+            return owner->template Field<Member>()[index];
+        }
 
-        // consteval
-        // {
+        operator TContainer() const { return owner->Get(index); }
 
-        // };
+        const TProxy& operator=(const TContainer& elem) const
+        {
+            owner->Set(index, elem);
+            return *this;
+        }
     };
+
+    using Proxy      = TProxy<SOA>;
+    using ConstProxy = TProxy<const SOA>;
+
+    Proxy operator[](const u32 index)
+    {
+        assert(index < NumElements);
+        return {this, index};
+    }
+
+    ConstProxy operator[](const u32 index) const
+    {
+        assert(index < NumElements);
+        return {this, index};
+    }
+
+  private:
+    template <size_t I, auto Member>
+    static consteval bool is_member()
+    {
+        if constexpr (std::is_same_v<decltype(Member),
+                                     std::tuple_element_t<I, Fields>>)
+        {
+            return std::get<I>(Schema::Members) == Member;
+        }
+        return false;
+    }
+
+    template <typename Func>
+    static constexpr void for_each_field(Func&& func)
+    {
+        [&]<size_t... I>(std::index_sequence<I...>)
+        {
+            (func.template operator()<(u32)I>(), ...);
+        }(std::make_index_sequence<NumFields>{});
+    }
+
+    void store(u32 index, const TContainer& elem)
+    {
+        for_each_field(
+            [&]<u32 I>()
+            {
+                Field<I>().Data[index] = elem.*std::get<I>(Schema::Members);
+            });
+    }
 };
@@ -1,7 +1,8 @@
 #pragma once
 
 #include "../core/core.hpp"
-#include "../core/Pool.hpp"
+#include "../core/ConcurrentPool.hpp"
+#include "../core/DirtyRanges.hpp"
 
 #include <vulkan/vulkan_core.h>
 
@@ -15,15 +16,117 @@ enum BindlessType : u8
 
 typedef PoolHandle<u32, 24, 8> BindlessHandle;
 
+struct Texture
+{
+    VkImageView   image_view = VK_NULL_HANDLE;
+    VkImageLayout layout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+};
+
 class BindlessHeapManager final
 {
   public:
     [[nodiscard]] BindlessHeapManager(VkDevice& vulkan_device)
-        : texture_heap(allocator, 64), device(vulkan_device)
+        : texture_heap(texture_allocator, 64), dirty_ranges(allocator, 64u),
+          image_infos(allocator, 256u), writes(allocator, 64u),
+          pending_slots{DynamicBitlist<64u>(allocator),
+                        DynamicBitlist<64u>(allocator)},
+          device(vulkan_device)
     {
     }
 
-    void update_descriptorsets();
+    /*
+     * Writes the texture slots that changed since they were last written to
+     * this frame's descriptor set, then moves on to the other set, so the set
+     * used by the previous frame is never touched. A change stays pending for
+     * each set until that set is written. Runs of changed slots (closer than
+     * DescriptorMergeGap) become a single VkWriteDescriptorSet.
+     *
+     * Free slots are written with fallback_view, which needs the
+     * nullDescriptor feature while it's VK_NULL_HANDLE.
+     */
+    void update_descriptorsets()
+    {
+        // loaders can add chunks while this runs, so slots are only known
+        // to fit once they are handed out
+        texture_heap.consume_dirty(
+            [&](u32 slot)
+            {
+                for (DynamicBitlist<64u>& pending : pending_slots)
+                {
+                    if (slot >= pending.size_bits())
+                    {
+                        pending.resize(slot + 1u);
+                    }
+                    pending.set_bit(slot);
+                }
+            });
+
+        const VkDescriptorSet set     = descriptor_set[current_set];
+        DynamicBitlist<64u>&  pending = pending_slots[current_set];
+        current_set ^= 1u;
+
+        if (set == VK_NULL_HANDLE || pending.find_first(true) < 0)
+        {
+            return;
+        }
+
+        dirty_ranges.NumElements = 0u;
+        bitlist_ranges(pending, dirty_ranges, DescriptorMergeGap);
+
+        // all image infos first, the writes point into them
+        image_infos.NumElements = 0u;
+        for (u32 r = 0; r < dirty_ranges.NumElements; r++)
+        {
+            const BitRange range = dirty_ranges[r];
+            const u32      first = image_infos.NumElements;
+            image_infos.add_no_init(range.Size());
+
+            for (u32 slot = range.begin; slot < range.end; slot++)
+            {
+                const Texture* texture = texture_heap.get_slot(slot);
+
+                image_infos[first + slot - range.begin] = {
+                    .sampler     = VK_NULL_HANDLE,
+                    .imageView   = texture ? texture->image_view : fallback_view,
+                    .imageLayout = texture ? texture->layout
+                                           : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                };
+            }
+        }
+
+        writes.NumElements = 0u;
+        writes.add_no_init(dirty_ranges.NumElements);
+
+        u32 first_info = 0u;
+        for (u32 r = 0; r < dirty_ranges.NumElements; r++)
+        {
+            writes[r] = {
+                .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet          = set,
+                .dstBinding      = (u32)BindlessType::TEXTURE,
+                .dstArrayElement = dirty_ranges[r].begin,
+                .descriptorCount = dirty_ranges[r].Size(),
+                .descriptorType  = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+                .pImageInfo      = &image_infos.Data[first_info],
+            };
+            first_info += dirty_ranges[r].Size();
+        }
+
+        vkUpdateDescriptorSets(device, writes.NumElements, writes.Data, 0u,
+                               nullptr);
+
+        for (u32 i = 0; i < pending.num_chunks(); i++)
+        {
+            pending.chunks[i] = DynamicBitlist<64u>::Chunk();
+        }
+        pending.rebuild_summaries();
+    }
+
+    // The set written by the last update_descriptorsets()
+    VkDescriptorSet current_descriptor_set() const
+    {
+        return descriptor_set[current_set ^ 1u];
+    }
 
     // TODO(bert): figure out how to do this best: as in do we bind this using a
     // unique layout or do we want to append to other temporal cohese layout
@@ -39,11 +142,32 @@ class BindlessHeapManager final
     // *pDynamicOffsets)
     // }
 
+  private:
+    // declared before the members that allocate from them on construction.
+    // texture_heap allocates from loader threads under its own mutex, the
+    // arena is only used by the render thread (scratch, pending_slots)
+    ArenaAllocator<> allocator = ArenaAllocator(MB(256));
+    HeapAllocator    texture_allocator;
+
   public:
-    Pool<struct Texture, BindlessHandle> texture_heap;
+    // loaders on worker threads add textures directly
+    ConcurrentPool<Texture, BindlessHandle> texture_heap;
+
+    // written to free slots
+    VkImageView fallback_view = VK_NULL_HANDLE;
 
   private:
-    ArenaAllocator<> allocator = ArenaAllocator(MB(256));
+    // rewriting a few unchanged slots is cheaper than another write
+    static constexpr u32 DescriptorMergeGap = 8u;
+
+    // scratch for update_descriptorsets, kept to reuse the memory
+    Array<BitRange>              dirty_ranges;
+    Array<VkDescriptorImageInfo> image_infos;
+    Array<VkWriteDescriptorSet>  writes;
+
+    // texture slots not yet written to each of the descriptor sets
+    DynamicBitlist<64u> pending_slots[2];
+    u32                 current_set = 0u;
 
     // vulkan objects
     VkDevice& device;
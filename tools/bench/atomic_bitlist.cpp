@@ -0,0 +1,81 @@
+#include "bench.hpp"
+#include "core/AtomicBitList.hpp"
+#include <thread>
+
+/*
+ * Threads repeatedly claim a handful of slots and release them again. With
+ * every thread starting its scan at bit 0 they all fight over the first
+ * words; thread_hint() gives each thread its own starting word.
+ */
+template <typename List>
+static void run_contention(const char* name, List& list, u32 num_threads,
+                           bool use_hint)
+{
+    constexpr u32 Rounds   = 200000u;
+    constexpr u32 PerRound = 8u;
+
+    Bench::Clock::time_point start = Bench::Clock::now();
+
+    std::thread threads[64];
+    for (u32 t = 0u; t < num_threads; t++)
+    {
+        threads[t] = std::thread(
+            [&list, t, num_threads, use_hint]
+            {
+                u32 hint = use_hint ? list.thread_hint(t, num_threads) : 0u;
+                i32 held[PerRound];
+
+                for (u32 round = 0u; round < Rounds; round++)
+                {
+                    u32 num_held = 0u;
+                    for (; num_held < PerRound; num_held++)
+                    {
+                        held[num_held] = list.claim_first_free(hint);
+                        if (held[num_held] < 0)
+                        {
+                            break;
+                        }
+                    }
+
+                    for (u32 i = 0u; i < num_held; i++)
+                    {
+                        list.unset_bit((u32)held[i]);
+                    }
+                }
+            });
+    }
+
+    for (u32 t = 0u; t < num_threads; t++)
+    {
+        threads[t].join();
+    }
+
+    double seconds = Bench::seconds_since(start);
+    double claims  = (double)num_threads * Rounds * PerRound;
+
+    printf("%-8s threads %2u hint %-3s %8.2f Mclaims/s\n", name, num_threads,
+           use_hint ? "yes" : "no", claims / seconds * 1e-6);
+}
+
+void bench_atomic_bitlist()
+{
+    ArenaAllocator<> arena(MB(1));
+
+    AtomicBitList<4096>  fixed;
+    AtomicDynamicBitlist dynamic(arena, 4096u);
+
+    u32 max_threads = std::thread::hardware_concurrency();
+    if (max_threads > 64u)
+    {
+        max_threads = 64u;
+    }
+
+    for (u32 num_threads = 1u; num_threads <= max_threads; num_threads *= 2u)
+    {
+        for (bool use_hint : {false, true})
+        {
+            run_contention("fixed", fixed, num_threads, use_hint);
+            run_contention("dynamic", dynamic, num_threads, use_hint);
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "core/core.hpp"
+#include <chrono>
+#include <stdio.h>
+
+/*
+ * Micro benchmark drivers for the core containers and algorithms.
+ *
+ * Every bench_* function prints one line per measured configuration. The
+ * drivers build with the `Bench` project in premake5.lua; run them from a
+ * Release build:
+ *
+ *  AlineBench_release           run every benchmark
+ *  AlineBench_release radix     run only the benchmarks whose name is given
+ */
+
+namespace Bench
+{
+
+using Clock = std::chrono::steady_clock;
+
+inline double seconds_since(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/* Stops the optimizer from dropping a result that is never read. */
+template <typename T>
+inline void keep(const T& value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/* Cheap deterministic generator so runs are comparable. */
+struct Random
+{
+    u64 state = 0x9E3779B97F4A7C15ull;
+
+    inline u64 next()
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+};
+
+} // namespace Bench
+
+void bench_atomic_bitlist();
+void bench_radix_sort();
+void bench_search();
+void bench_priority_queue();
+void bench_hash();
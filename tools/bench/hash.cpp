@@ -0,0 +1,63 @@
+#include "bench.hpp"
+#include "core/Hash.hpp"
+#include <vector>
+
+/*
+ * Hashes the same buffer over and over at sizes from 8 bytes to 1 MB. Small
+ * sizes show per call latency, large ones the bulk throughput of the
+ * dispatched kernel. The seed chains through the previous digest so calls
+ * can not overlap completely.
+ */
+void bench_hash()
+{
+    constexpr u64 BytesPerSize = MB(256);
+
+    std::vector<u8> buffer(MB(1) + 64u);
+    Bench::Random   rng;
+    for (u8& byte : buffer)
+    {
+        byte = (u8)rng.next();
+    }
+
+    for (u64 size = 8u; size <= MB(1); size *= 2u)
+    {
+        const u64 iterations = BytesPerSize / size;
+
+        u64 digest = 0u;
+
+        Bench::Clock::time_point start = Bench::Clock::now();
+        for (u64 i = 0u; i < iterations; i++)
+        {
+            digest = hash_bytes(buffer.data() + (i & 63u), size, digest);
+        }
+        double seconds = Bench::seconds_since(start);
+
+        Bench::keep(digest);
+
+        printf("%8llu B %8.2f GB/s %10.2f ns/hash\n", size,
+               (double)(size * iterations) / seconds * 1e-9,
+               seconds * 1e9 / (double)iterations);
+    }
+
+    // Also time the last size through the streaming Hasher in 4 KB updates.
+    const u64 iterations = BytesPerSize / MB(1);
+
+    u64 digest = 0u;
+
+    Bench::Clock::time_point start = Bench::Clock::now();
+    for (u64 i = 0u; i < iterations; i++)
+    {
+        Hasher hasher(digest);
+        for (u64 offset = 0u; offset < MB(1); offset += KB(4))
+        {
+            hasher.update(buffer.data() + offset, KB(4));
+        }
+        digest = hasher.finish();
+    }
+    double seconds = Bench::seconds_since(start);
+
+    Bench::keep(digest);
+
+    printf("Hasher 1 MB in 4 KB updates %8.2f GB/s\n",
+           (double)(MB(1) * iterations) / seconds * 1e-9);
+}
@@ -0,0 +1,36 @@
+#include "bench.hpp"
+#include <string.h>
+
+struct BenchEntry
+{
+    const char* name;
+    void (*run)();
+};
+
+static const BenchEntry benches[] = {
+    {"atomic_bitlist", bench_atomic_bitlist},
+    {"radix_sort", bench_radix_sort},
+    {"search", bench_search},
+    {"priority_queue", bench_priority_queue},
+    {"hash", bench_hash},
+};
+
+int main(int argc, char** argv)
+{
+    for (const BenchEntry& bench : benches)
+    {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc; i++)
+        {
+            selected |= strstr(bench.name, argv[i]) != nullptr;
+        }
+
+        if (selected)
+        {
+            printf("== %s\n", bench.name);
+            bench.run();
+        }
+    }
+
+    return 0;
+}
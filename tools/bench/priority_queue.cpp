@@ -0,0 +1,108 @@
+#include "bench.hpp"
+#include "core/PriorityQueue.hpp"
+#include <queue>
+#include <vector>
+
+/*
+ * Two workloads per size: push every key then pop them all, and a steady
+ * state where a full heap pops its minimum and pushes a new key, as an
+ * event queue or Dijkstra frontier does.
+ */
+template <u32 D>
+static double run_dary(ArenaAllocator<>& arena, const std::vector<u32>& keys,
+                       bool steady)
+{
+    Bench::Clock::time_point start = Bench::Clock::now();
+
+    DaryHeap<u32, D> heap(arena, (u32)keys.size());
+    u64              sum = 0u;
+
+    for (u32 key : keys)
+    {
+        heap.push(key);
+    }
+
+    if (steady)
+    {
+        for (u32 key : keys)
+        {
+            sum += heap.pop();
+            heap.push(key ^ (u32)sum);
+        }
+    }
+
+    while (!heap.is_empty())
+    {
+        sum += heap.pop();
+    }
+
+    Bench::keep(sum);
+    return Bench::seconds_since(start);
+}
+
+static double run_std(const std::vector<u32>& keys, bool steady)
+{
+    Bench::Clock::time_point start = Bench::Clock::now();
+
+    std::vector<u32> storage;
+    storage.reserve(keys.size());
+
+    std::priority_queue<u32, std::vector<u32>, std::greater<>> heap(
+        std::greater<>(), std::move(storage));
+    u64 sum = 0u;
+
+    for (u32 key : keys)
+    {
+        heap.push(key);
+    }
+
+    if (steady)
+    {
+        for (u32 key : keys)
+        {
+            sum += heap.top();
+            heap.pop();
+            heap.push(key ^ (u32)sum);
+        }
+    }
+
+    while (!heap.empty())
+    {
+        sum += heap.top();
+        heap.pop();
+    }
+
+    Bench::keep(sum);
+    return Bench::seconds_since(start);
+}
+
+void bench_priority_queue()
+{
+    ArenaAllocator<> arena(MB(64));
+    Bench::Random    rng;
+
+    for (u32 num_keys : {1000u, 100000u, 1000000u, 10000000u})
+    {
+        std::vector<u32> keys(num_keys);
+        for (u32& key : keys)
+        {
+            key = (u32)rng.next();
+        }
+
+        for (bool steady : {false, true})
+        {
+            double std_seconds = run_std(keys, steady);
+            double binary      = run_dary<2u>(arena, keys, steady);
+            arena.FreeAll();
+            double quaternary = run_dary<4u>(arena, keys, steady);
+            arena.FreeAll();
+            double octonary = run_dary<8u>(arena, keys, steady);
+            arena.FreeAll();
+
+            printf("%-9s n %8u ms std::pq %9.3f d=2 %9.3f d=4 %9.3f d=8 "
+                   "%9.3f\n",
+                   steady ? "steady" : "push/pop", num_keys, std_seconds * 1e3,
+                   binary * 1e3, quaternary * 1e3, octonary * 1e3);
+        }
+    }
+}
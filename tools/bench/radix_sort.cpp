@@ -0,0 +1,46 @@
+#include "bench.hpp"
+#include "core/Algorithms/Sort.hpp"
+#include <algorithm>
+#include <vector>
+
+template <typename KeyT>
+static void run_sort(const char* name, ArenaAllocator<>& scratch, u32 num_keys)
+{
+    Bench::Random rng;
+
+    std::vector<KeyT> source(num_keys);
+    for (KeyT& key : source)
+    {
+        key = (KeyT)rng.next();
+    }
+
+    std::vector<KeyT> radix  = source;
+    std::vector<KeyT> sorted = source;
+
+    Bench::Clock::time_point start = Bench::Clock::now();
+    AE::radix_sort(View<KeyT>{radix.data(), num_keys}, scratch);
+    double radix_seconds = Bench::seconds_since(start);
+
+    start = Bench::Clock::now();
+    std::sort(sorted.begin(), sorted.end());
+    double sort_seconds = Bench::seconds_since(start);
+
+    assert(radix == sorted);
+
+    printf("%-4s n %9u radix %9.3f ms std::sort %9.3f ms (%.2fx)\n", name,
+           num_keys, radix_seconds * 1e3, sort_seconds * 1e3,
+           sort_seconds / radix_seconds);
+}
+
+void bench_radix_sort()
+{
+    // Scratch for the ping-pong buffer of the largest u64 run.
+    ArenaAllocator<> scratch(MB(96));
+
+    for (u32 num_keys : {10000u, 100000u, 1000000u, 10000000u})
+    {
+        run_sort<u32>("u32", scratch, num_keys);
+        run_sort<i32>("i32", scratch, num_keys);
+        run_sort<u64>("u64", scratch, num_keys);
+    }
+}
@@ -0,0 +1,97 @@
+#include "bench.hpp"
+#include "core/Algorithms/Search.hpp"
+#include <algorithm>
+#include <vector>
+
+/*
+ * Sweeps the sorted array from L1 sized to well past the last level cache.
+ * Binary searches are timed per query on random keys, linear scans as
+ * bandwidth for a key near the end of the array.
+ */
+static void run_search(u32 num_keys)
+{
+    constexpr u32 NumQueries = 1u << 20;
+
+    // Scan at least 256 MB so small arrays are not dominated by timer noise.
+    const u32 num_scans = (u32)(MB(256) / (sizeof(u32) * num_keys)) + 4u;
+
+    std::vector<u32> keys(num_keys);
+    for (u32 i = 0u; i < num_keys; i++)
+    {
+        keys[i] = i * 2u;
+    }
+    View<const u32> sorted{keys.data(), num_keys};
+
+    // Eytzinger keeps a key and a rank per slot.
+    ArenaAllocator<> arena(2u * sizeof(u32) * ((size_t)num_keys + 1u) + KB(4));
+    AE::EytzingerArray<u32> eytzinger(arena, sorted);
+
+    Bench::Random    rng;
+    std::vector<u32> queries(NumQueries);
+    for (u32& query : queries)
+    {
+        query = (u32)(rng.next() % (2ull * num_keys));
+    }
+
+    u64 sum = 0u;
+
+    Bench::Clock::time_point start = Bench::Clock::now();
+    for (u32 query : queries)
+    {
+        sum += std::lower_bound(keys.begin(), keys.end(), query) - keys.begin();
+    }
+    double std_seconds = Bench::seconds_since(start);
+
+    start = Bench::Clock::now();
+    for (u32 query : queries)
+    {
+        sum += AE::lower_bound(sorted, query);
+    }
+    double branchless_seconds = Bench::seconds_since(start);
+
+    start = Bench::Clock::now();
+    for (u32 query : queries)
+    {
+        sum += eytzinger.lower_bound(query);
+    }
+    double eytzinger_seconds = Bench::seconds_since(start);
+
+    const u32 targets[2] = {keys[num_keys - 1u], keys[num_keys - 2u]};
+
+    start = Bench::Clock::now();
+    for (u32 scan = 0u; scan < num_scans; scan++)
+    {
+        sum += AE::find_linear_simd(sorted, targets[scan % 2u]);
+    }
+    double simd_seconds = Bench::seconds_since(start);
+
+    start = Bench::Clock::now();
+    for (u32 scan = 0u; scan < num_scans; scan++)
+    {
+        sum += std::find(keys.begin(), keys.end(), targets[scan % 2u]) -
+               keys.begin();
+    }
+    double find_seconds = Bench::seconds_since(start);
+
+    Bench::keep(sum);
+
+    double scanned_bytes = (double)num_scans * num_keys * sizeof(u32);
+
+    printf("%8zu KB | lower_bound ns/query std %6.1f branchless %6.1f "
+           "eytzinger %6.1f | scan GB/s simd %6.2f std::find %6.2f\n",
+           sizeof(u32) * (size_t)num_keys / 1024u,
+           std_seconds * 1e9 / NumQueries,
+           branchless_seconds * 1e9 / NumQueries,
+           eytzinger_seconds * 1e9 / NumQueries,
+           scanned_bytes / simd_seconds * 1e-9,
+           scanned_bytes / find_seconds * 1e-9);
+}
+
+void bench_search()
+{
+    // 4 KB up to 64 MB of keys: L1, L2, last level cache and DRAM.
+    for (u32 num_keys = 1u << 10; num_keys <= 1u << 24; num_keys <<= 2)
+    {
+        run_search(num_keys);
+    }
+}